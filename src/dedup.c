@@ -0,0 +1,442 @@
+/*
+ * Content-defined chunking and deduplication routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * The stream is cut into chunks with a FastCDC style gear hash: the
+ * hash is rolled a byte at a time and a chunk ends when the masked
+ * bits are all zero.  A stricter mask is used before the average
+ * chunk size and a looser one after to keep the sizes near the
+ * average.  Each chunk is fingerprinted with md5 and looked up in a
+ * table of the chunks we have seen to count the duplicates.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include "dedup.h"
+#include "md5.h"
+
+/* FastCDC masks with 15 and 11 bits spread over the top of the hash */
+#define MASK_SMALL	0x0003590703530000ULL
+#define MASK_LARGE	0x0000d90003530000ULL
+
+/* the gear hash only remembers the last 64 bytes */
+#define HASH_WINDOW	64
+
+#define TABLE_START_SIZE	4096	/* starting number of slots */
+#define GEAR_SEED	0x6e756c6c2d636463ULL	/* seed for the gear table */
+
+static	unsigned long long	gear_table[256];
+static	int			gear_init_b = 0;
+
+/*
+ * Generate the gear table with splitmix64 so it is the same on every
+ * system and run.
+ */
+static	void	gear_init(void)
+{
+  unsigned long long	state = GEAR_SEED;
+  int			gear_c;
+
+  for (gear_c = 0; gear_c < 256; gear_c++) {
+    unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    gear_table[gear_c] = z ^ (z >> 31);
+  }
+  gear_init_b = 1;
+}
+
+/*
+ * Get the table index for a signature.  The md5 bytes are already
+ * evenly distributed so we just use the first of them.
+ */
+static	unsigned long	sig_index(const unsigned char *sig,
+				  const unsigned long table_size)
+{
+  unsigned long	index = 0;
+  int		sig_c;
+
+  for (sig_c = 0; sig_c < (int)sizeof(unsigned long); sig_c++) {
+    index = (index << 8) | sig[sig_c];
+  }
+  return index & (table_size - 1);
+}
+
+/*
+ * static int table_insert
+ *
+ * DESCRIPTION:
+ *
+ * Add a chunk signature to the table if it is not already there.
+ * The table is doubled when it gets half full.
+ *
+ * RETURNS:
+ *
+ * Success - 1 if the chunk is new, 0 if we have seen it before.
+ *
+ * Failure - -1 if we could not grow the table.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ *
+ * sig -> Md5 signature of the chunk.
+ *
+ * len -> Length of the chunk.
+ */
+static	int	table_insert(dedup_t *dedup_p, const unsigned char *sig,
+			     const unsigned long len)
+{
+  dedup_entry_t	*entry_p;
+  unsigned long	index;
+
+  if ((dedup_p->dd_unique_c + 1) * 2 > dedup_p->dd_table_size) {
+    unsigned long	new_size = dedup_p->dd_table_size * 2, entry_c;
+    dedup_entry_t	*new_table;
+
+    new_table = (dedup_entry_t *)calloc(new_size, sizeof(dedup_entry_t));
+    if (new_table == NULL) {
+      return -1;
+    }
+    for (entry_c = 0; entry_c < dedup_p->dd_table_size; entry_c++) {
+      entry_p = dedup_p->dd_table + entry_c;
+      if (entry_p->de_len == 0) {
+	continue;
+      }
+      index = sig_index(entry_p->de_sig, new_size);
+      while (new_table[index].de_len != 0) {
+	index = (index + 1) & (new_size - 1);
+      }
+      new_table[index] = *entry_p;
+    }
+    free(dedup_p->dd_table);
+    dedup_p->dd_table = new_table;
+    dedup_p->dd_table_size = new_size;
+  }
+
+  index = sig_index(sig, dedup_p->dd_table_size);
+  for (;;) {
+    entry_p = dedup_p->dd_table + index;
+    if (entry_p->de_len == 0) {
+      break;
+    }
+    if (entry_p->de_len == len
+	&& memcmp(entry_p->de_sig, sig, MD5_SIZE) == 0) {
+      return 0;
+    }
+    index = (index + 1) & (dedup_p->dd_table_size - 1);
+  }
+
+  memcpy(entry_p->de_sig, sig, MD5_SIZE);
+  entry_p->de_len = len;
+  return 1;
+}
+
+/*
+ * static int store_chunk
+ *
+ * DESCRIPTION:
+ *
+ * Write a new chunk into the store as <dir>/<2 hex>/<md5 hex> unless
+ * it is already there from a previous run.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ *
+ * sig_str -> Hex string of the chunk's md5 signature.
+ */
+static	int	store_chunk(dedup_t *dedup_p, const char *sig_str)
+{
+  char		path[1024];
+  struct stat	statbuf;
+  FILE		*outfile;
+
+  (void)snprintf(path, sizeof(path), "%s/%.2s", dedup_p->dd_store_dir,
+		 sig_str);
+  if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+    return -1;
+  }
+  (void)snprintf(path, sizeof(path), "%s/%.2s/%s", dedup_p->dd_store_dir,
+		 sig_str, sig_str);
+  if (stat(path, &statbuf) == 0) {
+    return 0;
+  }
+
+  outfile = fopen(path, "w");
+  if (outfile == NULL) {
+    return -1;
+  }
+  if (fwrite(dedup_p->dd_chunk_buf, sizeof(char), dedup_p->dd_chunk_len,
+	     outfile) != dedup_p->dd_chunk_len) {
+    (void)fclose(outfile);
+    return -1;
+  }
+  if (fclose(outfile) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Finish the current chunk, count it, and store it if needed.
+ */
+static	int	end_chunk(dedup_t *dedup_p)
+{
+  unsigned char	sig[MD5_SIZE];
+  char		sig_str[MD5_SIZE * 2 + 1];
+  int		new_b;
+
+  md5_finish(&dedup_p->dd_md5, sig);
+
+  new_b = table_insert(dedup_p, sig, dedup_p->dd_chunk_len);
+  if (new_b < 0) {
+    return -1;
+  }
+  dedup_p->dd_chunk_c++;
+  dedup_p->dd_byte_c += dedup_p->dd_chunk_len;
+  if (new_b) {
+    dedup_p->dd_unique_c++;
+    dedup_p->dd_unique_byte_c += dedup_p->dd_chunk_len;
+  }
+
+  if (dedup_p->dd_store_dir != NULL) {
+    md5_sig_to_string(sig, sig_str, sizeof(sig_str));
+    if (new_b && store_chunk(dedup_p, sig_str) != 0) {
+      return -1;
+    }
+    if (fprintf(dedup_p->dd_recipe, "%s %lu\n", sig_str,
+		dedup_p->dd_chunk_len) < 0) {
+      return -1;
+    }
+  }
+
+  md5_init(&dedup_p->dd_md5);
+  dedup_p->dd_chunk_len = 0;
+  dedup_p->dd_hash = 0;
+  return 0;
+}
+
+/*
+ * Add a piece of the current chunk to its md5 and its store copy.
+ */
+static	void	add_to_chunk(dedup_t *dedup_p, const unsigned char *buf,
+			     const unsigned long len)
+{
+  if (len == 0) {
+    return;
+  }
+  md5_process(&dedup_p->dd_md5, buf, len);
+  if (dedup_p->dd_chunk_buf != NULL) {
+    memcpy(dedup_p->dd_chunk_buf + dedup_p->dd_chunk_len, buf, len);
+  }
+  dedup_p->dd_chunk_len += len;
+}
+
+/*
+ * int dedup_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize the deduplication state.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate memory or create the store
+ * recipe.  errno will be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to the state that we are initializing.
+ *
+ * store_dir -> Directory where the unique chunks and the recipe to
+ * rebuild the stream from them are written.  If NULL then we only
+ * collect the statistics.
+ */
+int	dedup_init(dedup_t *dedup_p, const char *store_dir)
+{
+  char	path[1024];
+
+  if (! gear_init_b) {
+    gear_init();
+  }
+
+  memset(dedup_p, 0, sizeof(*dedup_p));
+  md5_init(&dedup_p->dd_md5);
+
+  dedup_p->dd_table_size = TABLE_START_SIZE;
+  dedup_p->dd_table = (dedup_entry_t *)calloc(TABLE_START_SIZE,
+					      sizeof(dedup_entry_t));
+  if (dedup_p->dd_table == NULL) {
+    return -1;
+  }
+
+  if (store_dir != NULL) {
+    dedup_p->dd_store_dir = store_dir;
+    if (mkdir(store_dir, 0777) != 0 && errno != EEXIST) {
+      return -1;
+    }
+    dedup_p->dd_chunk_buf = (char *)malloc(DEDUP_MAX_CHUNK);
+    if (dedup_p->dd_chunk_buf == NULL) {
+      return -1;
+    }
+    (void)snprintf(path, sizeof(path), "%s/%s", store_dir,
+		   DEDUP_RECIPE_NAME);
+    dedup_p->dd_recipe = fopen(path, "w");
+    if (dedup_p->dd_recipe == NULL) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * int dedup_process
+ *
+ * DESCRIPTION:
+ *
+ * Run a buffer of the stream through the chunker.  Chunks can span
+ * any number of calls.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the chunk store.  errno will
+ * be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ *
+ * buf -> Buffer of stream bytes.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+int	dedup_process(dedup_t *dedup_p, const char *buf,
+		      const unsigned long buf_len)
+{
+  const unsigned char	*buf_p = (const unsigned char *)buf;
+  const unsigned char	*start_p = buf_p, *bounds_p = buf_p + buf_len;
+  unsigned long long	hash = dedup_p->dd_hash;
+  /* length of the chunk including what we have scanned of this buffer */
+  unsigned long		len = dedup_p->dd_chunk_len;
+
+  while (buf_p < bounds_p) {
+
+    /* no cut can happen before the minimum so skip the hashing */
+    if (len < DEDUP_MIN_CHUNK - HASH_WINDOW) {
+      unsigned long skip = DEDUP_MIN_CHUNK - HASH_WINDOW - len;
+      if (skip > (unsigned long)(bounds_p - buf_p)) {
+	skip = bounds_p - buf_p;
+      }
+      buf_p += skip;
+      len += skip;
+      continue;
+    }
+
+    hash = (hash << 1) + gear_table[*buf_p++];
+    len++;
+    if (len < DEDUP_MIN_CHUNK) {
+      continue;
+    }
+    if (len < DEDUP_MAX_CHUNK
+	&& (hash & (len < DEDUP_AVG_CHUNK ? MASK_SMALL : MASK_LARGE)) != 0) {
+      continue;
+    }
+
+    add_to_chunk(dedup_p, start_p, buf_p - start_p);
+    if (end_chunk(dedup_p) != 0) {
+      return -1;
+    }
+    start_p = buf_p;
+    hash = 0;
+    len = 0;
+  }
+
+  add_to_chunk(dedup_p, start_p, buf_p - start_p);
+  dedup_p->dd_hash = hash;
+  return 0;
+}
+
+/*
+ * int dedup_finish
+ *
+ * DESCRIPTION:
+ *
+ * Finish the last chunk of the stream and close the store recipe.
+ * The table of chunks is freed.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the chunk store.  errno will
+ * be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ */
+int	dedup_finish(dedup_t *dedup_p)
+{
+  int	ret = 0;
+
+  if (dedup_p->dd_chunk_len > 0 && end_chunk(dedup_p) != 0) {
+    ret = -1;
+  }
+
+  if (dedup_p->dd_recipe != NULL) {
+    if (fclose(dedup_p->dd_recipe) != 0) {
+      ret = -1;
+    }
+    dedup_p->dd_recipe = NULL;
+  }
+  if (dedup_p->dd_chunk_buf != NULL) {
+    free(dedup_p->dd_chunk_buf);
+    dedup_p->dd_chunk_buf = NULL;
+  }
+  if (dedup_p->dd_table != NULL) {
+    free(dedup_p->dd_table);
+    dedup_p->dd_table = NULL;
+  }
+
+  return ret;
+}
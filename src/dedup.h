@@ -0,0 +1,143 @@
+/*
+ * Content-defined chunking and deduplication defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __DEDUP_H__
+#define __DEDUP_H__
+
+#include <stdio.h>			/* for FILE * below */
+
+#include "md5.h"
+
+/* chunk size limits, the average is where the normalization switches */
+#define DEDUP_MIN_CHUNK		2048
+#define DEDUP_AVG_CHUNK		8192
+#define DEDUP_MAX_CHUNK		65536
+
+/* name of the recipe file in the chunk store directory */
+#define DEDUP_RECIPE_NAME	"recipe"
+
+/*
+ * Entry in the table of chunks that we have seen.  A length of 0
+ * marks an empty slot.
+ */
+typedef struct {
+  unsigned char		de_sig[MD5_SIZE];	/* md5 of the chunk */
+  unsigned long		de_len;			/* length of the chunk */
+} dedup_entry_t;
+
+/*
+ * State of the chunker and the statistics about the chunks.
+ */
+typedef struct {
+  unsigned long long	dd_hash;		/* rolling gear hash */
+  unsigned long		dd_chunk_len;		/* bytes in current chunk */
+  md5_t			dd_md5;			/* current chunk's md5 */
+  char			*dd_chunk_buf;		/* chunk copy for store */
+
+  dedup_entry_t		*dd_table;		/* chunks we have seen */
+  unsigned long		dd_table_size;		/* slots in the table */
+
+  unsigned long long	dd_chunk_c;		/* number of chunks */
+  unsigned long long	dd_unique_c;		/* number of unique chunks */
+  unsigned long long	dd_byte_c;		/* number of bytes */
+  unsigned long long	dd_unique_byte_c;	/* bytes in unique chunks */
+
+  const char		*dd_store_dir;		/* chunk store or NULL */
+  FILE			*dd_recipe;		/* recipe in the store */
+} dedup_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int dedup_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize the deduplication state.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate memory or create the store
+ * recipe.  errno will be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to the state that we are initializing.
+ *
+ * store_dir -> Directory where the unique chunks and the recipe to
+ * rebuild the stream from them are written.  If NULL then we only
+ * collect the statistics.
+ */
+extern
+int	dedup_init(dedup_t *dedup_p, const char *store_dir);
+
+/*
+ * int dedup_process
+ *
+ * DESCRIPTION:
+ *
+ * Run a buffer of the stream through the chunker.  Chunks can span
+ * any number of calls.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the chunk store.  errno will
+ * be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ *
+ * buf -> Buffer of stream bytes.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+extern
+int	dedup_process(dedup_t *dedup_p, const char *buf,
+		      const unsigned long buf_len);
+
+/*
+ * int dedup_finish
+ *
+ * DESCRIPTION:
+ *
+ * Finish the last chunk of the stream and close the store recipe.
+ * The table of chunks is freed.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the chunk store.  errno will
+ * be set.
+ *
+ * ARGUMENTS:
+ *
+ * dedup_p -> Pointer to our deduplication state.
+ */
+extern
+int	dedup_finish(dedup_t *dedup_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __DEDUP_H__ */
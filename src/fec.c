@@ -0,0 +1,753 @@
+/*
+ * Reed-Solomon forward error correction routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * With --fec the pagination stream is cut into blocks and each group
+ * of K data blocks is followed by M parity blocks.  Every block is
+ * framed with a header carrying its group, its index, and a crc so the
+ * reader can tell which blocks were damaged or cut off.  After a bad
+ * frame the reader scans for the next magic with a good crc so bytes
+ * lost from the middle of the stream only cost the frames they were
+ * in.  As long as no more than M blocks of a group are bad the data
+ * blocks are rebuilt from any K good ones.
+ *
+ * The parity rows are a Cauchy matrix over GF(2^8) so every K rows of
+ * the identity stacked on it can be inverted.  Multiplying a block by
+ * a constant is a lookup in a 256 byte row of the product table which
+ * keeps the inner loop to a load, a lookup, and an xor.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "argv.h"
+#include "iobuf.h"
+#include "fec.h"
+
+#define GF_POLY		0x11d		/* x^8 + x^4 + x^3 + x^2 + 1 */
+#define CRC_POLY	0xedb88320UL	/* reflected crc-32 */
+
+/* offsets of the fields in a frame header after the magic */
+#define HEAD_K		4
+#define HEAD_M		5
+#define HEAD_INDEX	6
+#define HEAD_GROUP	8
+#define HEAD_CRC	16
+
+#define SHARD(fec_p, idx)	((fec_p)->fe_shards + (idx) * FEC_SHARD_SIZE)
+
+static	int		tables_b = 0;		/* tables are built */
+static	unsigned char	gf_exp[512];		/* anti-logs doubled */
+static	unsigned char	gf_log[256];		/* logs */
+static	unsigned char	gf_mul[256][256];	/* product table */
+static	unsigned long	crc_table[256];		/* crc-32 by byte */
+
+/*
+ * Build the GF(2^8) and crc tables the first time we need them.
+ */
+static	void	build_tables(void)
+{
+  unsigned int	val, a_c, b_c, bit_c;
+
+  if (tables_b) {
+    return;
+  }
+
+  val = 1;
+  for (a_c = 0; a_c < 255; a_c++) {
+    gf_exp[a_c] = val;
+    gf_exp[a_c + 255] = val;
+    gf_log[val] = a_c;
+    val <<= 1;
+    if (val & 0x100) {
+      val ^= GF_POLY;
+    }
+  }
+  for (a_c = 0; a_c < 256; a_c++) {
+    for (b_c = 0; b_c < 256; b_c++) {
+      if (a_c == 0 || b_c == 0) {
+	gf_mul[a_c][b_c] = 0;
+      }
+      else {
+	gf_mul[a_c][b_c] = gf_exp[gf_log[a_c] + gf_log[b_c]];
+      }
+    }
+  }
+
+  for (a_c = 0; a_c < 256; a_c++) {
+    unsigned long crc = a_c;
+    for (bit_c = 0; bit_c < 8; bit_c++) {
+      crc = (crc & 1 ? (crc >> 1) ^ CRC_POLY : crc >> 1);
+    }
+    crc_table[a_c] = crc;
+  }
+
+  tables_b = 1;
+}
+
+/*
+ * Return the multiplicative inverse of a non-zero field element.
+ */
+static	unsigned char	gf_inverse(const unsigned char val)
+{
+  return gf_exp[255 - gf_log[val]];
+}
+
+/*
+ * Add coef times the src region into dest.  A coefficient of 1 is
+ * just an xor.
+ */
+static	void	region_muladd(unsigned char *dest, const unsigned char *src,
+			      const unsigned char coef, const unsigned long len)
+{
+  const unsigned char	*row = gf_mul[coef];
+  unsigned long		len_c;
+
+  if (coef == 0) {
+    return;
+  }
+  if (coef == 1) {
+    for (len_c = 0; len_c < len; len_c++) {
+      dest[len_c] ^= src[len_c];
+    }
+    return;
+  }
+  for (len_c = 0; len_c < len; len_c++) {
+    dest[len_c] ^= row[src[len_c]];
+  }
+}
+
+/*
+ * Continue a crc-32 over another buffer.
+ */
+static	unsigned long	crc_add(unsigned long crc, const unsigned char *buf,
+				const unsigned long len)
+{
+  unsigned long	len_c;
+
+  for (len_c = 0; len_c < len; len_c++) {
+    crc = crc_table[(crc ^ buf[len_c]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+/*
+ * Store and load big-endian numbers in the headers and shards.
+ */
+static	void	put_be(unsigned char *buf, unsigned long long val, int len)
+{
+  while (len-- > 0) {
+    buf[len] = val & 0xff;
+    val >>= 8;
+  }
+}
+
+static	unsigned long long	get_be(const unsigned char *buf, const int len)
+{
+  unsigned long long	val = 0;
+  int			len_c;
+
+  for (len_c = 0; len_c < len; len_c++) {
+    val = (val << 8) | buf[len_c];
+  }
+  return val;
+}
+
+/*
+ * Return the crc of a frame which covers the header after the magic
+ * up to the crc and the shard.
+ */
+static	unsigned long	frame_crc(const unsigned char *header,
+				  const char *shard)
+{
+  unsigned long	crc = 0xffffffffUL;
+
+  crc = crc_add(crc, header + FEC_MAGIC_LEN, HEAD_CRC - FEC_MAGIC_LEN);
+  crc = crc_add(crc, (const unsigned char *)shard, FEC_SHARD_SIZE);
+  return crc ^ 0xffffffffUL;
+}
+
+/*
+ * Write one shard of the current group framed with its header.
+ */
+static	int	write_frame(fec_t *fec_p, const int fd, const int idx)
+{
+  unsigned char	header[FEC_HEADER_SIZE];
+  struct iovec	iov[2];
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, FEC_MAGIC, FEC_MAGIC_LEN);
+  header[HEAD_K] = fec_p->fe_k;
+  header[HEAD_M] = fec_p->fe_m;
+  header[HEAD_INDEX] = idx;
+  put_be(header + HEAD_GROUP, fec_p->fe_group, 8);
+  put_be(header + HEAD_CRC, frame_crc(header, SHARD(fec_p, idx)), 4);
+
+  iov[0].iov_base = header;
+  iov[0].iov_len = FEC_HEADER_SIZE;
+  iov[1].iov_base = SHARD(fec_p, idx);
+  iov[1].iov_len = FEC_SHARD_SIZE;
+  if (iobuf_writev(fd, iov, 2) != FEC_FRAME_SIZE) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * The current data shard is done so write it out and if it finishes
+ * the group then work out and write the parity.
+ */
+static	int	end_shard(fec_t *fec_p, const int fd)
+{
+  int	par_c, data_c;
+
+  put_be((unsigned char *)SHARD(fec_p, fec_p->fe_shard_c), fec_p->fe_fill, 4);
+  if (fec_p->fe_fill < FEC_BLOCK_SIZE) {
+    memset(SHARD(fec_p, fec_p->fe_shard_c) + 4 + fec_p->fe_fill, 0,
+	   FEC_BLOCK_SIZE - fec_p->fe_fill);
+  }
+  if (write_frame(fec_p, fd, fec_p->fe_shard_c) != 0) {
+    return -1;
+  }
+  fec_p->fe_shard_c++;
+  fec_p->fe_fill = 0;
+  if (fec_p->fe_shard_c < fec_p->fe_k) {
+    return 0;
+  }
+
+  for (par_c = 0; par_c < fec_p->fe_m; par_c++) {
+    char *parity = SHARD(fec_p, fec_p->fe_k + par_c);
+    memset(parity, 0, FEC_SHARD_SIZE);
+    for (data_c = 0; data_c < fec_p->fe_k; data_c++) {
+      region_muladd((unsigned char *)parity,
+		    (unsigned char *)SHARD(fec_p, data_c),
+		    fec_p->fe_matrix[par_c * fec_p->fe_k + data_c],
+		    FEC_SHARD_SIZE);
+    }
+    if (write_frame(fec_p, fd, fec_p->fe_k + par_c) != 0) {
+      return -1;
+    }
+    fec_p->fe_parity_bytes += FEC_FRAME_SIZE;
+  }
+  fec_p->fe_shard_c = 0;
+  fec_p->fe_group++;
+  fec_p->fe_group_n++;
+  return 0;
+}
+
+/*
+ * Invert the k x k solve matrix into the inverse with Gauss-Jordan
+ * elimination.  Returns -1 if it is singular which should not happen
+ * with a Cauchy matrix.
+ */
+static	int	invert_matrix(fec_t *fec_p)
+{
+  unsigned char	*mat = fec_p->fe_solve, *inv = fec_p->fe_inverse;
+  unsigned char	tmp, coef;
+  int		k = fec_p->fe_k, row_c, col_c, pivot_c;
+
+  memset(inv, 0, k * k);
+  for (row_c = 0; row_c < k; row_c++) {
+    inv[row_c * k + row_c] = 1;
+  }
+
+  for (col_c = 0; col_c < k; col_c++) {
+    for (pivot_c = col_c; pivot_c < k; pivot_c++) {
+      if (mat[pivot_c * k + col_c] != 0) {
+	break;
+      }
+    }
+    if (pivot_c == k) {
+      return -1;
+    }
+    if (pivot_c != col_c) {
+      for (row_c = 0; row_c < k; row_c++) {
+	tmp = mat[pivot_c * k + row_c];
+	mat[pivot_c * k + row_c] = mat[col_c * k + row_c];
+	mat[col_c * k + row_c] = tmp;
+	tmp = inv[pivot_c * k + row_c];
+	inv[pivot_c * k + row_c] = inv[col_c * k + row_c];
+	inv[col_c * k + row_c] = tmp;
+      }
+    }
+
+    /* scale the pivot row to 1 and clear the column from the others */
+    coef = gf_inverse(mat[col_c * k + col_c]);
+    for (row_c = 0; row_c < k; row_c++) {
+      mat[col_c * k + row_c] = gf_mul[coef][mat[col_c * k + row_c]];
+      inv[col_c * k + row_c] = gf_mul[coef][inv[col_c * k + row_c]];
+    }
+    for (row_c = 0; row_c < k; row_c++) {
+      coef = mat[row_c * k + col_c];
+      if (row_c == col_c || coef == 0) {
+	continue;
+      }
+      region_muladd(mat + row_c * k, mat + col_c * k, coef, k);
+      region_muladd(inv + row_c * k, inv + col_c * k, coef, k);
+    }
+  }
+  return 0;
+}
+
+/*
+ * Is the frame that we have read in a good one of our stream?
+ */
+static	int	frame_good(const fec_t *fec_p)
+{
+  const unsigned char	*header = (unsigned char *)fec_p->fe_frame;
+  const char		*shard = fec_p->fe_frame + FEC_HEADER_SIZE;
+
+  return (memcmp(header, FEC_MAGIC, FEC_MAGIC_LEN) == 0
+	  && header[HEAD_K] == fec_p->fe_k && header[HEAD_M] == fec_p->fe_m
+	  && header[HEAD_INDEX] < fec_p->fe_k + fec_p->fe_m
+	  && get_be(header + HEAD_CRC, 4) == frame_crc(header, shard)
+	  && (header[HEAD_INDEX] >= fec_p->fe_k
+	      || get_be((const unsigned char *)shard, 4) <= FEC_BLOCK_SIZE));
+}
+
+/*
+ * Read until fe_frame holds the next good frame.  Bytes that aren't
+ * part of one are skipped by looking for the magic of the next.
+ * Returns 1 if we have a frame, 0 at EOF, or -1 on error.
+ */
+static	int	next_frame(fec_t *fec_p, const int fd)
+{
+  char		*frame = fec_p->fe_frame;
+  unsigned long	skip, len;
+  long		ret;
+
+  while (1) {
+    while (fec_p->fe_frame_len < FEC_FRAME_SIZE) {
+      ret = read(fd, frame + fec_p->fe_frame_len,
+		 FEC_FRAME_SIZE - fec_p->fe_frame_len);
+      if (ret < 0 && errno == EINTR) {
+	continue;
+      }
+      if (ret < 0) {
+	return -1;
+      }
+      if (ret == 0) {
+	/* a short frame at the end can't be a good one */
+	fec_p->fe_frame_len = 0;
+	return 0;
+      }
+      fec_p->fe_frame_len += ret;
+    }
+    if (frame_good(fec_p)) {
+      return 1;
+    }
+
+    /* move down to the next magic or the bytes that could start one */
+    for (skip = 1; skip < FEC_FRAME_SIZE; skip++) {
+      len = FEC_FRAME_SIZE - skip;
+      if (len > FEC_MAGIC_LEN) {
+	len = FEC_MAGIC_LEN;
+      }
+      if (memcmp(frame + skip, FEC_MAGIC, len) == 0) {
+	break;
+      }
+    }
+    memmove(frame, frame + skip, FEC_FRAME_SIZE - skip);
+    fec_p->fe_frame_len = FEC_FRAME_SIZE - skip;
+  }
+}
+
+/*
+ * Read the next group of frames and rebuild any of its data shards
+ * that were damaged.  Frames come in index order so a good frame
+ * after a gap means the ones in between were lost, and a frame of a
+ * later group is kept for the next call.  The shards that we have are
+ * kept in fec_p so a non-blocking input picks up where it left off.
+ * Returns 1 if we have a group, 0 on EOF, or -1 on error.
+ */
+static	int	read_group(fec_t *fec_p, const int fd)
+{
+  unsigned char		*header = (unsigned char *)fec_p->fe_frame;
+  char			*good = fec_p->fe_good;
+  int			k = fec_p->fe_k, total = fec_p->fe_k + fec_p->fe_m;
+  int			idx, bad_n, rebuilt_n = 0, row_n, data_c;
+  int			row_c, ret;
+  unsigned long long	group;
+
+  /* the input ended in the group we already handed out */
+  if (fec_p->fe_eof_b) {
+    return 0;
+  }
+
+  /* starting a new group rather than resuming one */
+  if (fec_p->fe_good_n == 0) {
+    memset(good, 0, sizeof(fec_p->fe_good));
+  }
+  while (1) {
+    ret = next_frame(fec_p, fd);
+    if (ret < 0) {
+      return -1;
+    }
+    if (ret == 0) {
+      fec_p->fe_eof_b = 1;
+      if (fec_p->fe_good_n == 0) {
+	return 0;
+      }
+      break;
+    }
+    group = get_be(header + HEAD_GROUP, 8);
+    if (group > fec_p->fe_group) {
+      /* the rest of this group was lost */
+      break;
+    }
+    idx = header[HEAD_INDEX];
+    if (group == fec_p->fe_group && (! good[idx])) {
+      memcpy(SHARD(fec_p, idx), fec_p->fe_frame + FEC_HEADER_SIZE,
+	     FEC_SHARD_SIZE);
+      good[idx] = 1;
+      fec_p->fe_good_n++;
+    }
+    /* we are done with the frame unless it is a later group's */
+    fec_p->fe_frame_len = 0;
+    if (idx == total - 1) {
+      break;
+    }
+  }
+
+  bad_n = total - fec_p->fe_good_n;
+  fec_p->fe_good_n = 0;
+  if (bad_n > fec_p->fe_m) {
+    (void)fprintf(stderr,
+		  "%s: ERROR.  fec group %llu has %d bad blocks but only %d "
+		  "parity\n",
+		  argv_program, fec_p->fe_group, bad_n, fec_p->fe_m);
+    errno = EIO;
+    return -1;
+  }
+
+  /* only lost data blocks need rebuilding */
+  for (data_c = 0; data_c < k; data_c++) {
+    if (! good[data_c]) {
+      rebuilt_n++;
+    }
+  }
+  if (rebuilt_n > 0) {
+    int rows[FEC_MAX_BLOCKS];
+
+    /* pick the first k good blocks and their rows of the encoding */
+    row_n = 0;
+    for (idx = 0; idx < total && row_n < k; idx++) {
+      if (! good[idx]) {
+	continue;
+      }
+      if (idx < k) {
+	memset(fec_p->fe_solve + row_n * k, 0, k);
+	fec_p->fe_solve[row_n * k + idx] = 1;
+      }
+      else {
+	memcpy(fec_p->fe_solve + row_n * k,
+	       fec_p->fe_matrix + (idx - k) * k, k);
+      }
+      rows[row_n++] = idx;
+    }
+    if (invert_matrix(fec_p) != 0) {
+      (void)fprintf(stderr, "%s: ERROR.  fec group %llu could not be solved\n",
+		    argv_program, fec_p->fe_group);
+      errno = EIO;
+      return -1;
+    }
+
+    for (data_c = 0; data_c < k; data_c++) {
+      if (good[data_c]) {
+	continue;
+      }
+      char *shard = SHARD(fec_p, data_c);
+      memset(shard, 0, FEC_SHARD_SIZE);
+      for (row_c = 0; row_c < k; row_c++) {
+	region_muladd((unsigned char *)shard,
+		      (unsigned char *)SHARD(fec_p, rows[row_c]),
+		      fec_p->fe_inverse[data_c * k + row_c], FEC_SHARD_SIZE);
+      }
+      if (get_be((unsigned char *)shard, 4) > FEC_BLOCK_SIZE) {
+	(void)fprintf(stderr,
+		      "%s: ERROR.  fec group %llu rebuilt a bad block\n",
+		      argv_program, fec_p->fe_group);
+	errno = EIO;
+	return -1;
+      }
+    }
+    fec_p->fe_repaired += rebuilt_n;
+    fec_p->fe_repaired_groups++;
+  }
+  fec_p->fe_group++;
+  fec_p->fe_group_n++;
+  return 1;
+}
+
+/*
+ * int fec_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the state for encoding or decoding groups of k data and m
+ * parity blocks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the counts are out of range or we could not
+ * allocate the state.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Pointer to the state we are initializing.
+ *
+ * k -> Number of data blocks in each group.
+ *
+ * m -> Number of parity blocks in each group.
+ */
+int	fec_init(fec_t *fec_p, const int k, const int m)
+{
+  int	par_c, data_c;
+
+  memset(fec_p, 0, sizeof(*fec_p));
+  if (k < 1 || m < 1 || k + m > FEC_MAX_BLOCKS) {
+    return -1;
+  }
+  build_tables();
+
+  fec_p->fe_k = k;
+  fec_p->fe_m = m;
+  fec_p->fe_matrix = (unsigned char *)malloc(m * k);
+  fec_p->fe_solve = (unsigned char *)malloc(k * k);
+  fec_p->fe_inverse = (unsigned char *)malloc(k * k);
+  fec_p->fe_shards = (char *)malloc((k + m) * FEC_SHARD_SIZE);
+  fec_p->fe_frame = (char *)malloc(FEC_FRAME_SIZE);
+  if (fec_p->fe_matrix == NULL || fec_p->fe_solve == NULL
+      || fec_p->fe_inverse == NULL || fec_p->fe_shards == NULL
+      || fec_p->fe_frame == NULL) {
+    fec_free(fec_p);
+    return -1;
+  }
+
+  /* cauchy rows of 1 / (x ^ y) with x from k up and y from 0 up */
+  for (par_c = 0; par_c < m; par_c++) {
+    for (data_c = 0; data_c < k; data_c++) {
+      fec_p->fe_matrix[par_c * k + data_c] = gf_inverse((k + par_c) ^ data_c);
+    }
+  }
+  return 0;
+}
+
+/*
+ * int fec_write
+ *
+ * DESCRIPTION:
+ *
+ * Add data to the stream writing out each data block as it fills and
+ * the parity blocks when a group is done.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if a write failed with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Encoding state.
+ *
+ * fd -> File descriptor that we are writing the frames to.
+ *
+ * iov -> Array of buffers of data to encode.
+ *
+ * iov_n -> Number of entries in the array.
+ */
+int	fec_write(fec_t *fec_p, const int fd, const struct iovec *iov,
+		  const int iov_n)
+{
+  unsigned long	off, len;
+  int		iov_c;
+
+  for (iov_c = 0; iov_c < iov_n; iov_c++) {
+    for (off = 0; off < iov[iov_c].iov_len; off += len) {
+      len = iov[iov_c].iov_len - off;
+      if (len > FEC_BLOCK_SIZE - fec_p->fe_fill) {
+	len = FEC_BLOCK_SIZE - fec_p->fe_fill;
+      }
+      memcpy(SHARD(fec_p, fec_p->fe_shard_c) + 4 + fec_p->fe_fill,
+	     (char *)iov[iov_c].iov_base + off, len);
+      fec_p->fe_fill += len;
+      fec_p->fe_data_bytes += len;
+      if (fec_p->fe_fill == FEC_BLOCK_SIZE && end_shard(fec_p, fd) != 0) {
+	return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * int fec_finish
+ *
+ * DESCRIPTION:
+ *
+ * Write out the last partial group padded with empty data blocks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if a write failed with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Encoding state.
+ *
+ * fd -> File descriptor that we are writing the frames to.
+ */
+int	fec_finish(fec_t *fec_p, const int fd)
+{
+  if (fec_p->fe_shard_c == 0 && fec_p->fe_fill == 0) {
+    return 0;
+  }
+  /* the reader skips the empty blocks since they have a length of 0 */
+  while (fec_p->fe_shard_c > 0 || fec_p->fe_fill > 0) {
+    if (end_shard(fec_p, fd) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * int fec_read
+ *
+ * DESCRIPTION:
+ *
+ * Read the data back out of a stream of frames a group at a time.
+ * Blocks that are damaged or missing are rebuilt from the rest of
+ * their group.
+ *
+ * RETURNS:
+ *
+ * Success - Number of data bytes read or 0 at EOF.
+ *
+ * Failure - -1 with errno set.  EIO means that a group had more
+ * damaged blocks than parity and the error has been printed.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Decoding state.
+ *
+ * fd -> File descriptor that we are reading frames from.
+ *
+ * buf -> Buffer we are reading into.
+ *
+ * buf_len -> Size of the buffer.
+ */
+int	fec_read(fec_t *fec_p, const int fd, char *buf,
+		 const unsigned long buf_len)
+{
+  unsigned long	shard_len, len;
+  char		*shard;
+  int		ret;
+
+  while (1) {
+    if (! fec_p->fe_ready_b) {
+      ret = read_group(fec_p, fd);
+      if (ret <= 0) {
+	if (ret == 0) {
+	  /* get ready for the next input if there is one */
+	  fec_p->fe_eof_b = 0;
+	  fec_p->fe_group = 0;
+	}
+	return ret;
+      }
+      fec_p->fe_ready_b = 1;
+      fec_p->fe_shard_c = 0;
+      fec_p->fe_fill = 0;
+    }
+
+    while (fec_p->fe_shard_c < fec_p->fe_k) {
+      shard = SHARD(fec_p, fec_p->fe_shard_c);
+      shard_len = get_be((unsigned char *)shard, 4);
+      if (fec_p->fe_fill < shard_len) {
+	len = shard_len - fec_p->fe_fill;
+	if (len > buf_len) {
+	  len = buf_len;
+	}
+	memcpy(buf, shard + 4 + fec_p->fe_fill, len);
+	fec_p->fe_fill += len;
+	fec_p->fe_data_bytes += len;
+	return len;
+      }
+      fec_p->fe_shard_c++;
+      fec_p->fe_fill = 0;
+    }
+    fec_p->fe_ready_b = 0;
+  }
+}
+
+/*
+ * void fec_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the encoding or decoding state.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> State that we are freeing.
+ */
+void	fec_free(fec_t *fec_p)
+{
+  if (fec_p->fe_matrix != NULL) {
+    free(fec_p->fe_matrix);
+    fec_p->fe_matrix = NULL;
+  }
+  if (fec_p->fe_solve != NULL) {
+    free(fec_p->fe_solve);
+    fec_p->fe_solve = NULL;
+  }
+  if (fec_p->fe_inverse != NULL) {
+    free(fec_p->fe_inverse);
+    fec_p->fe_inverse = NULL;
+  }
+  if (fec_p->fe_shards != NULL) {
+    free(fec_p->fe_shards);
+    fec_p->fe_shards = NULL;
+  }
+  if (fec_p->fe_frame != NULL) {
+    free(fec_p->fe_frame);
+    fec_p->fe_frame = NULL;
+  }
+}
@@ -0,0 +1,198 @@
+/*
+ * Reed-Solomon forward error correction defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __FEC_H__
+#define __FEC_H__
+
+#include <sys/uio.h>			/* for struct iovec below */
+
+/* data bytes in each block */
+#define FEC_BLOCK_SIZE		4096
+
+/* most data plus parity blocks in a group */
+#define FEC_MAX_BLOCKS		255
+
+/*
+ * Each block goes out as a frame of a header and a shard.  The shard
+ * is a 4 byte length of the data in it and the data padded to the
+ * block size.  The parity is over whole shards so a rebuilt block
+ * gets its length back as well.
+ */
+#define FEC_MAGIC		"NFEC"
+#define FEC_MAGIC_LEN		4
+#define FEC_HEADER_SIZE		20
+#define FEC_SHARD_SIZE		(4 + FEC_BLOCK_SIZE)
+#define FEC_FRAME_SIZE		(FEC_HEADER_SIZE + FEC_SHARD_SIZE)
+
+/*
+ * Encoding or decoding state of K data blocks and M parity blocks per
+ * group.
+ */
+typedef struct {
+  int			fe_k;			/* data blocks per group */
+  int			fe_m;			/* parity blocks per group */
+  unsigned char		*fe_matrix;		/* m x k parity rows */
+  unsigned char		*fe_solve;		/* k x k rows to invert */
+  unsigned char		*fe_inverse;		/* k x k inverted */
+  char			*fe_shards;		/* k data then m parity */
+  int			fe_shard_c;		/* shard we are filling */
+  unsigned long		fe_fill;		/* data bytes in it */
+  int			fe_ready_b;		/* decoded group to hand out */
+  int			fe_eof_b;		/* input ended */
+  char			*fe_frame;		/* frame being read */
+  unsigned long		fe_frame_len;		/* bytes read into it */
+  char			fe_good[FEC_MAX_BLOCKS]; /* shards of group read */
+  int			fe_good_n;		/* how many of them */
+  unsigned long long	fe_group;		/* current group number */
+  unsigned long long	fe_group_n;		/* groups in all inputs */
+  unsigned long long	fe_data_bytes;		/* data passed through */
+  unsigned long long	fe_parity_bytes;	/* parity written */
+  unsigned long long	fe_repaired;		/* data blocks rebuilt */
+  unsigned long long	fe_repaired_groups;	/* groups that needed it */
+} fec_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int fec_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the state for encoding or decoding groups of k data and m
+ * parity blocks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the counts are out of range or we could not
+ * allocate the state.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Pointer to the state we are initializing.
+ *
+ * k -> Number of data blocks in each group.
+ *
+ * m -> Number of parity blocks in each group.
+ */
+extern
+int	fec_init(fec_t *fec_p, const int k, const int m);
+
+/*
+ * int fec_write
+ *
+ * DESCRIPTION:
+ *
+ * Add data to the stream writing out each data block as it fills and
+ * the parity blocks when a group is done.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if a write failed with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Encoding state.
+ *
+ * fd -> File descriptor that we are writing the frames to.
+ *
+ * iov -> Array of buffers of data to encode.
+ *
+ * iov_n -> Number of entries in the array.
+ */
+extern
+int	fec_write(fec_t *fec_p, const int fd, const struct iovec *iov,
+		  const int iov_n);
+
+/*
+ * int fec_finish
+ *
+ * DESCRIPTION:
+ *
+ * Write out the last partial group padded with empty data blocks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if a write failed with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Encoding state.
+ *
+ * fd -> File descriptor that we are writing the frames to.
+ */
+extern
+int	fec_finish(fec_t *fec_p, const int fd);
+
+/*
+ * int fec_read
+ *
+ * DESCRIPTION:
+ *
+ * Read the data back out of a stream of frames a group at a time.
+ * Blocks that are damaged or missing are rebuilt from the rest of
+ * their group.
+ *
+ * RETURNS:
+ *
+ * Success - Number of data bytes read or 0 at EOF.
+ *
+ * Failure - -1 with errno set.  EIO means that a group had more
+ * damaged blocks than parity and the error has been printed.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> Decoding state.
+ *
+ * fd -> File descriptor that we are reading frames from.
+ *
+ * buf -> Buffer we are reading into.
+ *
+ * buf_len -> Size of the buffer.
+ */
+extern
+int	fec_read(fec_t *fec_p, const int fd, char *buf,
+		 const unsigned long buf_len);
+
+/*
+ * void fec_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the encoding or decoding state.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fec_p -> State that we are freeing.
+ */
+extern
+void	fec_free(fec_t *fec_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __FEC_H__ */
@@ -0,0 +1,197 @@
+/*
+ * Synthetic data generator routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * This lets null be the source end of a throughput test as well as
+ * the sink.  The random data comes from xoshiro256** which makes 8
+ * bytes in a handful of instructions so it runs at memory speed and,
+ * since it is seeded, the receiving end can regenerate the stream to
+ * check it.
+ */
+
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include "gen.h"
+
+#define WORD_SIZE	sizeof(unsigned long long)
+
+/*
+ * Mix the seed with splitmix64 to fill the xoshiro state as its
+ * authors recommend.
+ */
+static	unsigned long long	splitmix64(unsigned long long *seed_p)
+{
+  unsigned long long	val;
+  
+  *seed_p += 0x9E3779B97F4A7C15ULL;
+  val = *seed_p;
+  val = (val ^ (val >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  val = (val ^ (val >> 27)) * 0x94D049BB133111EBULL;
+  return val ^ (val >> 31);
+}
+
+#define ROTL(val, bits)	(((val) << (bits)) | ((val) >> (64 - (bits))))
+
+/*
+ * Return the next word from the xoshiro256** generator.
+ */
+static	unsigned long long	next_word(unsigned long long *state)
+{
+  unsigned long long	result = ROTL(state[1] * 5, 7) * 9;
+  unsigned long long	shift = state[1] << 17;
+  
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= shift;
+  state[3] = ROTL(state[3], 45);
+  
+  return result;
+}
+
+/*
+ * int gen_init
+ *
+ * DESCRIPTION:
+ *
+ * Setup a generator.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the type is not one that we know or the pattern is
+ * empty.
+ *
+ * ARGUMENTS:
+ *
+ * gen_p -> Generator that we are setting up.
+ *
+ * type -> Name of the type: zeros, pattern, or random.
+ *
+ * pattern -> String that the pattern type repeats.
+ *
+ * seed -> Seed of the random type.
+ */
+int	gen_init(gen_t *gen_p, const char *type, const char *pattern,
+		 const unsigned long seed)
+{
+  unsigned long long	mix = seed;
+  int			state_c;
+  
+  memset(gen_p, 0, sizeof(*gen_p));
+  if (strcmp(type, "zeros") == 0) {
+    gen_p->ge_type = GEN_ZEROS;
+  }
+  else if (strcmp(type, "pattern") == 0) {
+    gen_p->ge_type = GEN_PATTERN;
+  }
+  else if (strcmp(type, "random") == 0) {
+    gen_p->ge_type = GEN_RANDOM;
+  }
+  else {
+    return -1;
+  }
+  
+  gen_p->ge_pattern = pattern;
+  gen_p->ge_pattern_len = strlen(pattern);
+  if (gen_p->ge_type == GEN_PATTERN && gen_p->ge_pattern_len == 0) {
+    return -1;
+  }
+  
+  for (state_c = 0; state_c < 4; state_c++) {
+    gen_p->ge_state[state_c] = splitmix64(&mix);
+  }
+  return 0;
+}
+
+/*
+ * void gen_fill
+ *
+ * DESCRIPTION:
+ *
+ * Fill a buffer with the next bytes of the generated stream.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * gen_p -> Generator that we are using.
+ *
+ * buf <- Buffer that we are filling.
+ *
+ * size -> Number of bytes to generate.
+ */
+void	gen_fill(gen_t *gen_p, char *buf, const unsigned long size)
+{
+  char		*buf_p = buf, *bounds_p = buf + size;
+  unsigned long	len;
+  
+  if (gen_p->ge_type == GEN_ZEROS) {
+    memset(buf, 0, size);
+  }
+  else if (gen_p->ge_type == GEN_PATTERN) {
+    while (buf_p < bounds_p) {
+      unsigned long offset = (gen_p->ge_pos + (buf_p - buf))
+	% gen_p->ge_pattern_len;
+      len = gen_p->ge_pattern_len - offset;
+      if (len > (unsigned long)(bounds_p - buf_p)) {
+	len = bounds_p - buf_p;
+      }
+      memcpy(buf_p, gen_p->ge_pattern + offset, len);
+      buf_p += len;
+    }
+  }
+  else {
+    /* use up the rest of the word that the last fill stopped in */
+    unsigned int used = gen_p->ge_pos % WORD_SIZE;
+    if (used > 0) {
+      len = WORD_SIZE - used;
+      if (len > size) {
+	len = size;
+      }
+      memcpy(buf_p, (char *)&gen_p->ge_word + used, len);
+      buf_p += len;
+    }
+    
+    /* then whole words straight into the buffer */
+    while (bounds_p - buf_p >= (long)WORD_SIZE) {
+      gen_p->ge_word = next_word(gen_p->ge_state);
+      memcpy(buf_p, &gen_p->ge_word, WORD_SIZE);
+      buf_p += WORD_SIZE;
+    }
+    
+    /* and the start of a word that the next fill finishes */
+    if (buf_p < bounds_p) {
+      gen_p->ge_word = next_word(gen_p->ge_state);
+      memcpy(buf_p, &gen_p->ge_word, bounds_p - buf_p);
+    }
+  }
+  
+  gen_p->ge_pos += size;
+}
@@ -0,0 +1,98 @@
+/*
+ * Synthetic data generator defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __GEN_H__
+#define __GEN_H__
+
+/* the types of data that we generate */
+#define GEN_ZEROS		1	/* all zero bytes */
+#define GEN_PATTERN		2	/* a string repeated */
+#define GEN_RANDOM		3	/* seeded pseudo-random bytes */
+
+/* default string of the pattern type */
+#define GEN_DEFAULT_PATTERN	"0123456789abcdefghijklmnopqrstuvwxyz\n"
+
+/*
+ * Generator state.  The same type, pattern, and seed always produce
+ * the same stream of bytes however it is read.
+ */
+typedef struct {
+  int			ge_type;	/* GEN_ type */
+  const char		*ge_pattern;	/* pattern string */
+  unsigned long		ge_pattern_len;	/* length of pattern */
+  unsigned long long	ge_pos;		/* bytes generated so far */
+  unsigned long long	ge_state[4];	/* xoshiro256** state */
+  unsigned long long	ge_word;	/* random word being used up */
+} gen_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int gen_init
+ *
+ * DESCRIPTION:
+ *
+ * Setup a generator.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the type is not one that we know or the pattern is
+ * empty.
+ *
+ * ARGUMENTS:
+ *
+ * gen_p -> Generator that we are setting up.
+ *
+ * type -> Name of the type: zeros, pattern, or random.
+ *
+ * pattern -> String that the pattern type repeats.
+ *
+ * seed -> Seed of the random type.
+ */
+extern
+int	gen_init(gen_t *gen_p, const char *type, const char *pattern,
+		 const unsigned long seed);
+
+/*
+ * void gen_fill
+ *
+ * DESCRIPTION:
+ *
+ * Fill a buffer with the next bytes of the generated stream.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * gen_p -> Generator that we are using.
+ *
+ * buf <- Buffer that we are filling.
+ *
+ * size -> Number of bytes to generate.
+ */
+extern
+void	gen_fill(gen_t *gen_p, char *buf, const unsigned long size);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __GEN_H__ */
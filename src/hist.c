@@ -0,0 +1,237 @@
+/*
+ * Latency histogram routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * Recording a value is a couple of shifts and an increment so the
+ * stages can be timed on every buffer without skewing what we are
+ * measuring the way printing a line per operation does.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "conf.h"
+
+#include <sys/time.h>
+
+#include "hist.h"
+
+/* largest value that we can record, anything above is clamped */
+#define HIST_MAX_VALUE	((1ULL << HIST_MAX_BITS) - 1)
+
+/*
+ * Return the number of the highest bit set in a non-zero value.
+ */
+static	int	high_bit(unsigned long long value)
+{
+  int	bit_c = 0;
+
+  while (value >= 0x10000) {
+    value >>= 16;
+    bit_c += 16;
+  }
+  while (value > 1) {
+    value >>= 1;
+    bit_c++;
+  }
+  return bit_c;
+}
+
+/*
+ * Return the bucket that a value is counted in.  Values less than
+ * HIST_SUB_BUCKETS get a bucket each and above that each power of 2
+ * gets HIST_SUB_BUCKETS buckets.
+ */
+static	int	value_bucket(const unsigned long long value)
+{
+  int	bit_c;
+
+  if (value < HIST_SUB_BUCKETS) {
+    return (int)value;
+  }
+  bit_c = high_bit(value);
+  return (bit_c - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS
+    + (int)((value >> (bit_c - HIST_SUB_BITS)) - HIST_SUB_BUCKETS);
+}
+
+/*
+ * Return the highest value that is counted in a bucket.
+ */
+static	unsigned long long	bucket_value(const int bucket)
+{
+  int	group = bucket / HIST_SUB_BUCKETS;
+  int	sub = bucket % HIST_SUB_BUCKETS;
+
+  if (group == 0) {
+    return sub;
+  }
+  return ((unsigned long long)(HIST_SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+}
+
+/*
+ * unsigned long long hist_now
+ *
+ * DESCRIPTION:
+ *
+ * Get a monotonic time stamp for timing the stages.
+ *
+ * RETURNS:
+ *
+ * Current time in nanoseconds from some arbitrary point.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+unsigned long long	hist_now(void)
+{
+#if HAVE_CLOCK_GETTIME
+  struct timespec	now;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+  }
+#endif
+  {
+    struct timeval	tv;
+
+    (void)gettimeofday(&tv, NULL);
+    return (unsigned long long)tv.tv_sec * 1000000000ULL
+      + (unsigned long long)tv.tv_usec * 1000ULL;
+  }
+}
+
+/*
+ * void hist_record
+ *
+ * DESCRIPTION:
+ *
+ * Record a duration into a histogram.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * hist_p -> Pointer to the histogram we are recording into.
+ *
+ * value -> Duration in nanoseconds.
+ */
+void	hist_record(hist_t *hist_p, const unsigned long long value)
+{
+  unsigned long long	val = value;
+
+  if (val > HIST_MAX_VALUE) {
+    val = HIST_MAX_VALUE;
+  }
+  hist_p->hi_counts[value_bucket(val)]++;
+  hist_p->hi_total++;
+  if (value > hist_p->hi_max) {
+    hist_p->hi_max = value;
+  }
+}
+
+/*
+ * unsigned long long hist_percentile
+ *
+ * DESCRIPTION:
+ *
+ * Get the value at a percentile of the recorded durations.
+ *
+ * RETURNS:
+ *
+ * The highest value that is recorded in the bucket of the percentile
+ * or the maximum value if that is lower.
+ *
+ * ARGUMENTS:
+ *
+ * hist_p -> Pointer to the histogram we are examining.
+ *
+ * percentile -> Percentile from 0.0 to 100.0.
+ */
+unsigned long long	hist_percentile(const hist_t *hist_p,
+					const double percentile)
+{
+  unsigned long long	want, seen = 0, value;
+  int			bucket_c;
+
+  if (hist_p->hi_total == 0) {
+    return 0;
+  }
+
+  /* the rank of the value that we are looking for, rounded up */
+  want = (unsigned long long)(percentile / 100.0 * hist_p->hi_total + 0.5);
+  if (want < 1) {
+    want = 1;
+  }
+  else if (want > hist_p->hi_total) {
+    want = hist_p->hi_total;
+  }
+
+  for (bucket_c = 0; bucket_c < HIST_BUCKETS; bucket_c++) {
+    seen += hist_p->hi_counts[bucket_c];
+    if (seen >= want) {
+      break;
+    }
+  }
+
+  value = bucket_value(bucket_c);
+  if (value > hist_p->hi_max) {
+    value = hist_p->hi_max;
+  }
+  return value;
+}
+
+/*
+ * char *hist_duration
+ *
+ * DESCRIPTION:
+ *
+ * Format a nanosecond duration as a short string like 12.3us.
+ *
+ * RETURNS:
+ *
+ * The buffer passed in.
+ *
+ * ARGUMENTS:
+ *
+ * value -> Duration in nanoseconds.
+ *
+ * buf <- Buffer to format into.
+ *
+ * buf_size -> Size of the buffer.
+ */
+char	*hist_duration(const unsigned long long value, char *buf,
+		       const int buf_size)
+{
+  if (value < 1000ULL) {
+    (void)snprintf(buf, buf_size, "%lluns", value);
+  }
+  else if (value < 1000000ULL) {
+    (void)snprintf(buf, buf_size, "%.1fus", (double)value / 1000.0);
+  }
+  else if (value < 1000000000ULL) {
+    (void)snprintf(buf, buf_size, "%.1fms", (double)value / 1000000.0);
+  }
+  else {
+    (void)snprintf(buf, buf_size, "%.2fs", (double)value / 1000000000.0);
+  }
+  return buf;
+}
@@ -0,0 +1,133 @@
+/*
+ * Latency histogram defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __HIST_H__
+#define __HIST_H__
+
+/*
+ * The histograms are log-linear like HDR histograms: each power of 2
+ * is split into 2^HIST_SUB_BITS linear buckets so every value is
+ * recorded within about 3% of its real value.
+ */
+#define HIST_SUB_BITS		5
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS		48		/* up to ~3 days of ns */
+#define HIST_BUCKETS		((HIST_MAX_BITS - HIST_SUB_BITS + 1) \
+				 * HIST_SUB_BUCKETS)
+
+/* length of the buffer to hold a formatted duration */
+#define HIST_DURATION_LEN	32
+
+/*
+ * Histogram of nanosecond durations.
+ */
+typedef struct {
+  unsigned long long	hi_counts[HIST_BUCKETS];	/* bucket counts */
+  unsigned long long	hi_total;			/* number recorded */
+  unsigned long long	hi_max;				/* largest value */
+} hist_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * unsigned long long hist_now
+ *
+ * DESCRIPTION:
+ *
+ * Get a monotonic time stamp for timing the stages.
+ *
+ * RETURNS:
+ *
+ * Current time in nanoseconds from some arbitrary point.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+extern
+unsigned long long	hist_now(void);
+
+/*
+ * void hist_record
+ *
+ * DESCRIPTION:
+ *
+ * Record a duration into a histogram.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * hist_p -> Pointer to the histogram we are recording into.
+ *
+ * value -> Duration in nanoseconds.
+ */
+extern
+void	hist_record(hist_t *hist_p, const unsigned long long value);
+
+/*
+ * unsigned long long hist_percentile
+ *
+ * DESCRIPTION:
+ *
+ * Get the value at a percentile of the recorded durations.
+ *
+ * RETURNS:
+ *
+ * The highest value that is recorded in the bucket of the percentile
+ * or the maximum value if that is lower.
+ *
+ * ARGUMENTS:
+ *
+ * hist_p -> Pointer to the histogram we are examining.
+ *
+ * percentile -> Percentile from 0.0 to 100.0.
+ */
+extern
+unsigned long long	hist_percentile(const hist_t *hist_p,
+					const double percentile);
+
+/*
+ * char *hist_duration
+ *
+ * DESCRIPTION:
+ *
+ * Format a nanosecond duration as a short string like 12.3us.
+ *
+ * RETURNS:
+ *
+ * The buffer passed in.
+ *
+ * ARGUMENTS:
+ *
+ * value -> Duration in nanoseconds.
+ *
+ * buf <- Buffer to format into.
+ *
+ * buf_size -> Size of the buffer.
+ */
+extern
+char	*hist_duration(const unsigned long long value, char *buf,
+		       const int buf_size);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __HIST_H__ */
@@ -0,0 +1,445 @@
+/*
+ * I/O buffer allocation routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * The buffers that null moves its data through can be large and are
+ * touched on every byte so we try to back them with huge pages and
+ * keep them on the memory of the NUMA node that we are running on.
+ * Everything here falls back to malloc if mmap is not available.
+ *
+ * The data is written straight from them to the file descriptors of
+ * the outputs without going through stdio which would copy it into
+ * its own buffer and cut it up into small writes.
+ */
+
+/* for sched_getcpu, CPU_SET, and friends */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
+#if HAVE_SCHED_GETCPU && HAVE_SCHED_SETAFFINITY
+# include <sched.h>
+#endif
+#if HAVE_POLL
+# include <poll.h>
+#endif
+#include <limits.h>
+
+#include "iobuf.h"
+
+#define NODE_CPU_LIST	"/sys/devices/system/node/node%d/cpulist"
+#define MAX_NUMA_NODES	1024		/* max nodes that we look for */
+#define CPU_LIST_LEN	4096		/* length of the cpu-list line */
+#ifndef IOV_MAX
+# define IOV_MAX	16		/* iovecs per writev call */
+#endif
+
+/* allocation policy */
+static	int	use_huge_pages_b = 0;		/* use huge pages */
+static	int	use_numa_local_b = 0;		/* keep pages on local node */
+
+#if HAVE_SCHED_GETCPU && HAVE_SCHED_SETAFFINITY
+/*
+ * static int parse_cpu_list
+ *
+ * DESCRIPTION:
+ *
+ * Parse a kernel cpu-list string such as "0-15,32-47" into a cpu set.
+ *
+ * RETURNS:
+ *
+ * 1 if the cpu is in the list else 0.
+ *
+ * ARGUMENTS:
+ *
+ * list -> Cpu-list string that we are parsing.
+ *
+ * cpu -> Cpu number that we are looking for.
+ *
+ * set_p <- Pointer to a cpu set which is filled in with the list.
+ */
+static	int	parse_cpu_list(const char *list, const int cpu,
+			       cpu_set_t *set_p)
+{
+  const char	*list_p = list;
+  char		*end_p;
+  int		found_b = 0;
+
+  CPU_ZERO(set_p);
+  while (*list_p >= '0' && *list_p <= '9') {
+    long start = strtol(list_p, &end_p, 10);
+    long end = start;
+    list_p = end_p;
+    if (*list_p == '-') {
+      end = strtol(list_p + 1, &end_p, 10);
+      list_p = end_p;
+    }
+    for (; start <= end && start < CPU_SETSIZE; start++) {
+      CPU_SET(start, set_p);
+      if (start == cpu) {
+	found_b = 1;
+      }
+    }
+    if (*list_p != ',') {
+      break;
+    }
+    list_p++;
+  }
+
+  return found_b;
+}
+
+/*
+ * static void bind_local_node
+ *
+ * DESCRIPTION:
+ *
+ * Find the NUMA node of the CPU that we are running on and restrict
+ * ourselves to the CPUs of that node.  Since the kernel allocates
+ * pages on the node of the CPU that first touches them, this keeps
+ * our buffers and the code touching them on the same node.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	void	bind_local_node(void)
+{
+  char		path[128], list[CPU_LIST_LEN];
+  cpu_set_t	set;
+  FILE		*infile;
+  int		node;
+
+  int cpu = sched_getcpu();
+  if (cpu < 0) {
+    return;
+  }
+
+  for (node = 0; node < MAX_NUMA_NODES; node++) {
+    (void)snprintf(path, sizeof(path), NODE_CPU_LIST, node);
+    infile = fopen(path, "r");
+    if (infile == NULL) {
+      /* nodes may not be contiguous but we stop at the first gap */
+      if (node > 0) {
+	break;
+      }
+      continue;
+    }
+    if (fgets(list, sizeof(list), infile) == NULL) {
+      list[0] = '\0';
+    }
+    (void)fclose(infile);
+
+    if (parse_cpu_list(list, cpu, &set)) {
+      (void)sched_setaffinity(0, sizeof(set), &set);
+      return;
+    }
+  }
+}
+#endif /* HAVE_SCHED_GETCPU && HAVE_SCHED_SETAFFINITY */
+
+#if HAVE_MMAP
+/*
+ * Round the size up to the page size that we will be mapping.
+ */
+static	unsigned long	map_size(const unsigned long size)
+{
+  unsigned long	page_size;
+
+  if (use_huge_pages_b) {
+    page_size = IOBUF_HUGE_PAGE_SIZE;
+  }
+  else {
+    page_size = sysconf(_SC_PAGESIZE);
+  }
+  return (size + page_size - 1) / page_size * page_size;
+}
+#endif /* HAVE_MMAP */
+
+/*
+ * void iobuf_init
+ *
+ * DESCRIPTION:
+ *
+ * Set the allocation policy for all of the subsequent i/o buffers.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * huge_pages_b -> Set to 1 to back the buffers with huge pages.  We
+ * first try an explicit huge-page mapping and then fall back to
+ * asking for transparent huge-pages.
+ *
+ * numa_local_b -> Set to 1 to bind the process to the NUMA node of
+ * the CPU it is running on and to fault in the buffer pages as they
+ * are allocated so they come from that node's memory.
+ */
+void	iobuf_init(const int huge_pages_b, const int numa_local_b)
+{
+  use_huge_pages_b = huge_pages_b;
+  use_numa_local_b = numa_local_b;
+
+#if HAVE_SCHED_GETCPU && HAVE_SCHED_SETAFFINITY
+  if (use_numa_local_b) {
+    bind_local_node();
+  }
+#endif
+}
+
+/*
+ * void *iobuf_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate an i/o buffer according to the policy set by iobuf_init.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the buffer which must be passed to iobuf_free.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes that we are allocating.
+ */
+void	*iobuf_alloc(const unsigned long size)
+{
+  char	*buf;
+
+#if HAVE_MMAP
+  unsigned long len = map_size(size);
+  buf = MAP_FAILED;
+# ifdef MAP_HUGETLB
+  if (use_huge_pages_b) {
+    /* this only works if the admin has reserved huge pages */
+    buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+# endif
+  if (buf == MAP_FAILED) {
+    buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+      return NULL;
+    }
+# if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+    if (use_huge_pages_b) {
+      /* transparent huge pages, ignored if not supported */
+      (void)madvise(buf, len, MADV_HUGEPAGE);
+    }
+# endif
+  }
+#else
+  buf = malloc(size);
+  if (buf == NULL) {
+    return NULL;
+  }
+#endif /* ! HAVE_MMAP */
+
+  if (use_numa_local_b) {
+    /* first touch faults the pages in from our (now local) node */
+    unsigned long	touch_c;
+    long		page_size = 4096;
+#if HAVE_UNISTD_H
+    page_size = sysconf(_SC_PAGESIZE);
+#endif
+    for (touch_c = 0; touch_c < size; touch_c += page_size) {
+      buf[touch_c] = '\0';
+    }
+  }
+
+  return buf;
+}
+
+/*
+ * void iobuf_free
+ *
+ * DESCRIPTION:
+ *
+ * Free a buffer that was allocated with iobuf_alloc.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer we are freeing.
+ *
+ * size -> Size that was passed to iobuf_alloc.
+ */
+void	iobuf_free(void *buf, const unsigned long size)
+{
+  if (buf == NULL) {
+    return;
+  }
+#if HAVE_MMAP && HAVE_MUNMAP
+  (void)munmap(buf, map_size(size));
+#elif HAVE_MMAP
+  /* nothing we can do */
+#else
+  free(buf);
+#endif
+}
+
+/*
+ * Wait for a non-blocking descriptor that returned EAGAIN to be
+ * writable.
+ */
+static	void	wait_writable(const int fd)
+{
+#if HAVE_POLL
+  struct pollfd	pfd;
+  
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  (void)poll(&pfd, 1, -1);
+#else
+  (void)sleep(0);
+#endif
+}
+
+/*
+ * long iobuf_writev
+ *
+ * DESCRIPTION:
+ *
+ * Write all of an array of buffers to a file descriptor with as few
+ * system calls as we can.  Short writes are continued and writes
+ * that are interrupted or would block are tried again.
+ *
+ * RETURNS:
+ *
+ * Number of bytes written.  If this is less than the total of the
+ * buffers then the write failed and errno is set.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are writing to.
+ *
+ * iov <-> Array of buffers that we are writing.  The entries are
+ * advanced past what we have written.
+ *
+ * iov_n -> Number of entries in the array.
+ */
+long	iobuf_writev(const int fd, struct iovec *iov, const int iov_n)
+{
+  long	written = 0;
+  int	iov_c = 0;
+  
+  while (iov_c < iov_n) {
+    if (iov[iov_c].iov_len == 0) {
+      iov_c++;
+      continue;
+    }
+    
+#if HAVE_WRITEV
+    int write_n = iov_n - iov_c;
+    if (write_n > IOV_MAX) {
+      write_n = IOV_MAX;
+    }
+    ssize_t ret = writev(fd, iov + iov_c, write_n);
+#else
+    ssize_t ret = write(fd, iov[iov_c].iov_base, iov[iov_c].iov_len);
+#endif
+    if (ret < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	wait_writable(fd);
+	continue;
+      }
+      break;
+    }
+    if (ret == 0) {
+      /* shouldn't happen but we don't want to spin */
+      errno = EIO;
+      break;
+    }
+    
+    /* move past what we wrote which may be in the middle of an entry */
+    written += ret;
+    while (ret > 0) {
+      if ((size_t)ret < iov[iov_c].iov_len) {
+	iov[iov_c].iov_base = (char *)iov[iov_c].iov_base + ret;
+	iov[iov_c].iov_len -= ret;
+	break;
+      }
+      ret -= iov[iov_c].iov_len;
+      iov[iov_c].iov_len = 0;
+      iov_c++;
+    }
+  }
+  
+  return written;
+}
+
+/*
+ * long iobuf_write
+ *
+ * DESCRIPTION:
+ *
+ * Write all of a buffer to a file descriptor like iobuf_writev.
+ *
+ * RETURNS:
+ *
+ * Number of bytes written.  If this is less than buf_len then the
+ * write failed and errno is set.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are writing to.
+ *
+ * buf -> Buffer that we are writing.
+ *
+ * buf_len -> Length of the buffer.
+ */
+long	iobuf_write(const int fd, const void *buf, const unsigned long buf_len)
+{
+  struct iovec	iov;
+  
+  iov.iov_base = (void *)buf;
+  iov.iov_len = buf_len;
+  return iobuf_writev(fd, &iov, 1);
+}
@@ -0,0 +1,145 @@
+/*
+ * I/O buffer allocation defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __IOBUF_H__
+#define __IOBUF_H__
+
+#include <sys/uio.h>			/* for struct iovec below */
+
+/* size of a huge-page which we round up to when using them */
+#define IOBUF_HUGE_PAGE_SIZE	(2UL * 1024UL * 1024UL)
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void iobuf_init
+ *
+ * DESCRIPTION:
+ *
+ * Set the allocation policy for all of the subsequent i/o buffers.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * huge_pages_b -> Set to 1 to back the buffers with huge pages.  We
+ * first try an explicit huge-page mapping and then fall back to
+ * asking for transparent huge-pages.
+ *
+ * numa_local_b -> Set to 1 to bind the process to the NUMA node of
+ * the CPU it is running on and to fault in the buffer pages as they
+ * are allocated so they come from that node's memory.
+ */
+extern
+void	iobuf_init(const int huge_pages_b, const int numa_local_b);
+
+/*
+ * void *iobuf_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate an i/o buffer according to the policy set by iobuf_init.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the buffer which must be passed to iobuf_free.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes that we are allocating.
+ */
+extern
+void	*iobuf_alloc(const unsigned long size);
+
+/*
+ * void iobuf_free
+ *
+ * DESCRIPTION:
+ *
+ * Free a buffer that was allocated with iobuf_alloc.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer we are freeing.
+ *
+ * size -> Size that was passed to iobuf_alloc.
+ */
+extern
+void	iobuf_free(void *buf, const unsigned long size);
+
+/*
+ * long iobuf_writev
+ *
+ * DESCRIPTION:
+ *
+ * Write all of an array of buffers to a file descriptor with as few
+ * system calls as we can.  Short writes are continued and writes
+ * that are interrupted or would block are tried again.
+ *
+ * RETURNS:
+ *
+ * Number of bytes written.  If this is less than the total of the
+ * buffers then the write failed and errno is set.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are writing to.
+ *
+ * iov <-> Array of buffers that we are writing.  The entries are
+ * advanced past what we have written.
+ *
+ * iov_n -> Number of entries in the array.
+ */
+extern
+long	iobuf_writev(const int fd, struct iovec *iov, const int iov_n);
+
+/*
+ * long iobuf_write
+ *
+ * DESCRIPTION:
+ *
+ * Write all of a buffer to a file descriptor like iobuf_writev.
+ *
+ * RETURNS:
+ *
+ * Number of bytes written.  If this is less than buf_len then the
+ * write failed and errno is set.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are writing to.
+ *
+ * buf -> Buffer that we are writing.
+ *
+ * buf_len -> Length of the buffer.
+ */
+extern
+long	iobuf_write(const int fd, const void *buf, const unsigned long buf_len);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __IOBUF_H__ */
@@ -0,0 +1,600 @@
+/*
+ * Metrics exporter routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * The counters live in an anonymous shared mapping and the HTTP side
+ * runs in a forked process so null itself stays single threaded and
+ * a slow or stuck scraper can never hold up the data.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
+#if HAVE_SOCKET
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+#endif
+#if HAVE_POLL
+# include <poll.h>
+#endif
+
+#include "argv.h"
+#include "metrics.h"
+
+#if HAVE_MMAP && HAVE_SOCKET
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define DEFAULT_HOST	"127.0.0.1"	/* host if only a port is given */
+#define LISTEN_BACKLOG	16		/* pending scrape connections */
+#define REQUEST_SIZE	4096		/* max size of a request we read */
+#define POLL_MSECS	1000		/* how long we wait on a socket */
+#define BODY_BASE_SIZE	4096		/* body size before the files */
+#define BODY_FILE_SIZE	128		/* body size per file plus name */
+
+/* exporter state which the parent needs to stop it */
+static	pid_t		server_pid = -1;	/* exporter process */
+static	size_t		metrics_size = 0;	/* size of shared counters */
+static	char		*unix_path = NULL;	/* UNIX socket to remove */
+
+/*
+ * Append a printf formatted string to the response body.
+ */
+static	void	body_printf(char *body, const int body_size, int *len_p,
+			    const char *format, ...)
+{
+  va_list	ap;
+  int		len;
+
+  if (*len_p >= body_size) {
+    return;
+  }
+  va_start(ap, format);
+  len = vsnprintf(body + *len_p, body_size - *len_p, format, ap);
+  va_end(ap);
+  if (len > 0) {
+    *len_p += len;
+    if (*len_p > body_size) {
+      *len_p = body_size;
+    }
+  }
+}
+
+/*
+ * Copy a label value escaping the backslashes, quotes, and newlines
+ * that the exposition format does not allow in it.
+ */
+static	void	escape_label(const char *value, char *buf, const int buf_size)
+{
+  const char	*value_p;
+  char		*buf_p = buf, *bounds_p = buf + buf_size - 3;
+
+  for (value_p = value; *value_p != '\0' && buf_p < bounds_p; value_p++) {
+    if (*value_p == '\\' || *value_p == '"') {
+      *buf_p++ = '\\';
+      *buf_p++ = *value_p;
+    }
+    else if (*value_p == '\n') {
+      *buf_p++ = '\\';
+      *buf_p++ = 'n';
+    }
+    else {
+      *buf_p++ = *value_p;
+    }
+  }
+  *buf_p = '\0';
+}
+
+/*
+ * Write a counter with its help and type lines to the body.
+ */
+static	void	body_counter(char *body, const int body_size, int *len_p,
+			     const char *name, const char *help,
+			     const unsigned long long value)
+{
+  body_printf(body, body_size, len_p,
+	      "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+	      name, help, name, name, value);
+}
+
+/*
+ * static int build_body
+ *
+ * DESCRIPTION:
+ *
+ * Format the current value of the counters in the Prometheus text
+ * exposition format.
+ *
+ * RETURNS:
+ *
+ * Length of the body.
+ *
+ * ARGUMENTS:
+ *
+ * metrics_p -> Counters that we are reporting.
+ *
+ * file_names -> Names of the -f output files.
+ *
+ * file_n -> Number of output files.
+ *
+ * body <- Buffer that we format into.
+ *
+ * body_size -> Size of the buffer.
+ */
+static	int	build_body(metrics_t *metrics_p, char **file_names,
+			   const int file_n, char *body, const int body_size)
+{
+  char	label[1024];
+  int	len = 0, file_c;
+
+  body_counter(body, body_size, &len, "null_bytes_in_total",
+	       "Bytes read from the input.",
+	       METRICS_LOAD(metrics_p->me_bytes_in));
+  body_counter(body, body_size, &len, "null_reads_total",
+	       "Blocks read from the input.",
+	       METRICS_LOAD(metrics_p->me_reads));
+  body_counter(body, body_size, &len, "null_writes_total",
+	       "Blocks written to the outputs.",
+	       METRICS_LOAD(metrics_p->me_writes));
+  body_counter(body, body_size, &len,
+	       "null_pagination_escapes_inserted_total",
+	       "Mid escapes inserted by -w.",
+	       METRICS_LOAD(metrics_p->me_escapes_added));
+  body_counter(body, body_size, &len,
+	       "null_pagination_escapes_removed_total",
+	       "Mid escapes removed by -r.",
+	       METRICS_LOAD(metrics_p->me_escapes_removed));
+  body_counter(body, body_size, &len, "null_errors_total",
+	       "Errors that null carried on after.",
+	       METRICS_LOAD(metrics_p->me_errors));
+  body_counter(body, body_size, &len, "null_output_retries_total",
+	       "Writes to -f outputs that were retried.",
+	       METRICS_LOAD(metrics_p->me_retries));
+  body_counter(body, body_size, &len, "null_outputs_dropped_total",
+	       "Outputs that were dropped after errors.",
+	       METRICS_LOAD(metrics_p->me_outputs_dropped));
+
+  body_printf(body, body_size, &len,
+	      "# HELP null_throttle_sleep_seconds_total "
+	      "Time spent sleeping for -t.\n"
+	      "# TYPE null_throttle_sleep_seconds_total counter\n"
+	      "null_throttle_sleep_seconds_total %.6f\n",
+	      (double)METRICS_LOAD(metrics_p->me_throttle_ns) / 1000000000.0);
+
+  body_printf(body, body_size, &len,
+	      "# HELP null_bytes_out_total Bytes written to each output.\n"
+	      "# TYPE null_bytes_out_total counter\n"
+	      "null_bytes_out_total{output=\"stdout\"} %llu\n",
+	      METRICS_LOAD(metrics_p->me_stdout_bytes));
+  for (file_c = 0; file_c < file_n; file_c++) {
+    escape_label(file_names[file_c], label, sizeof(label));
+    body_printf(body, body_size, &len,
+		"null_bytes_out_total{output=\"%s\"} %llu\n",
+		label, METRICS_LOAD(metrics_p->me_file_bytes[file_c]));
+  }
+
+  return len;
+}
+
+/*
+ * Wait for a socket to be readable.  Returns 1 if it is, 0 on a
+ * timeout.
+ */
+static	int	wait_readable(const int fd)
+{
+#if HAVE_POLL
+  struct pollfd	pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return (poll(&pfd, 1, POLL_MSECS) > 0);
+#else
+  return 1;
+#endif
+}
+
+/*
+ * Write all of a buffer to a socket.
+ */
+static	void	write_all(const int fd, const char *buf, int len)
+{
+  while (len > 0) {
+    int ret = write(fd, buf, len);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return;
+    }
+    buf += ret;
+    len -= ret;
+  }
+}
+
+/*
+ * static void handle_request
+ *
+ * DESCRIPTION:
+ *
+ * Read a HTTP request from a connection and answer it.  Anything but
+ * a GET of / or /metrics gets a 404.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> Connection that we are answering.
+ *
+ * metrics_p -> Counters that we are reporting.
+ *
+ * file_names -> Names of the -f output files.
+ *
+ * file_n -> Number of output files.
+ */
+static	void	handle_request(const int fd, metrics_t *metrics_p,
+			       char **file_names, const int file_n)
+{
+  char	request[REQUEST_SIZE], header[256];
+  int	len = 0, header_len;
+
+  /* read until we see the end of the headers or give up */
+  while (len < (int)sizeof(request) - 1) {
+    if (! wait_readable(fd)) {
+      return;
+    }
+    int ret = read(fd, request + len, sizeof(request) - 1 - len);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    len += ret;
+    request[len] = '\0';
+    if (strstr(request, "\r\n\r\n") != NULL
+	|| strstr(request, "\n\n") != NULL) {
+      break;
+    }
+  }
+  request[len] = '\0';
+
+  if (strncmp(request, "GET / ", 6) != 0
+      && strncmp(request, "GET /metrics ", 13) != 0
+      && strncmp(request, "GET /metrics?", 13) != 0) {
+    const char *not_found = "not found\n";
+    header_len = snprintf(header, sizeof(header),
+			  "HTTP/1.0 404 Not Found\r\n"
+			  "Content-Type: text/plain\r\n"
+			  "Content-Length: %d\r\n"
+			  "Connection: close\r\n\r\n",
+			  (int)strlen(not_found));
+    write_all(fd, header, header_len);
+    write_all(fd, not_found, strlen(not_found));
+    return;
+  }
+
+  int body_size = BODY_BASE_SIZE;
+  int file_c;
+  for (file_c = 0; file_c < file_n; file_c++) {
+    body_size += BODY_FILE_SIZE + 2 * strlen(file_names[file_c]);
+  }
+  char *body = (char *)malloc(body_size);
+  if (body == NULL) {
+    return;
+  }
+  int body_len = build_body(metrics_p, file_names, file_n, body, body_size);
+  header_len = snprintf(header, sizeof(header),
+			"HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %d\r\n"
+			"Connection: close\r\n\r\n",
+			body_len);
+  write_all(fd, header, header_len);
+  write_all(fd, body, body_len);
+  free(body);
+}
+
+/*
+ * static void serve
+ *
+ * DESCRIPTION:
+ *
+ * Exporter process loop which answers connections until it is killed
+ * or it notices that null has gone away.
+ *
+ * RETURNS:
+ *
+ * Does not return.
+ *
+ * ARGUMENTS:
+ *
+ * listen_fd -> Socket that we accept connections on.
+ *
+ * metrics_p -> Counters that we are reporting.
+ *
+ * file_names -> Names of the -f output files.
+ *
+ * file_n -> Number of output files.
+ *
+ * parent -> Process id of null.
+ */
+static	void	serve(const int listen_fd, metrics_t *metrics_p,
+		      char **file_names, const int file_n, const pid_t parent)
+{
+  int	null_fd;
+
+  /* don't hold onto null's input or output which could stop an EOF */
+  null_fd = open("/dev/null", O_RDWR, 0);
+  if (null_fd >= 0) {
+    (void)dup2(null_fd, 0);
+    (void)dup2(null_fd, 1);
+    if (null_fd > 2) {
+      (void)close(null_fd);
+    }
+  }
+  (void)signal(SIGPIPE, SIG_IGN);
+  (void)signal(SIGUSR1, SIG_IGN);
+
+  while (1) {
+    if (! wait_readable(listen_fd)) {
+      if (getppid() != parent) {
+	_exit(0);
+      }
+      continue;
+    }
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    handle_request(fd, metrics_p, file_names, file_n);
+    (void)close(fd);
+  }
+}
+
+/*
+ * Open the socket that we listen on.  Returns the socket or -1 with
+ * the error printed.
+ */
+static	int	open_listen(const char *address)
+{
+  int	fd;
+
+  if (strchr(address, '/') != NULL) {
+    struct sockaddr_un	addr;
+    struct stat		statbuf;
+
+    if (strlen(address) >= sizeof(addr.sun_path)) {
+      (void)fprintf(stderr, "%s: metrics socket path too long: %s\n",
+		    argv_program, address);
+      return -1;
+    }
+    /* remove a socket left over from an earlier run */
+    if (stat(address, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode)) {
+      (void)unlink(address);
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      (void)fprintf(stderr, "%s: could not create metrics socket: %s\n",
+		    argv_program, strerror(errno));
+      return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, address);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      (void)fprintf(stderr, "%s: could not bind metrics socket %s: %s\n",
+		    argv_program, address, strerror(errno));
+      (void)close(fd);
+      return -1;
+    }
+    unix_path = strdup(address);
+  }
+  else {
+    struct sockaddr_in	addr;
+    char		host[64];
+    const char		*port_p;
+    int			on = 1;
+
+    port_p = strrchr(address, ':');
+    if (port_p == NULL) {
+      strcpy(host, DEFAULT_HOST);
+      port_p = address;
+    }
+    else {
+      int host_len = port_p - address;
+      if (host_len >= (int)sizeof(host)) {
+	host_len = sizeof(host) - 1;
+      }
+      memcpy(host, address, host_len);
+      host[host_len] = '\0';
+      port_p++;
+      if (host[0] == '\0' || strcmp(host, "localhost") == 0) {
+	strcpy(host, DEFAULT_HOST);
+      }
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(port_p));
+    if (*port_p == '\0' || inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+      (void)fprintf(stderr, "%s: invalid metrics address: %s\n",
+		    argv_program, address);
+      return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      (void)fprintf(stderr, "%s: could not create metrics socket: %s\n",
+		    argv_program, strerror(errno));
+      return -1;
+    }
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      (void)fprintf(stderr, "%s: could not bind metrics address %s: %s\n",
+		    argv_program, address, strerror(errno));
+      (void)close(fd);
+      return -1;
+    }
+  }
+
+  if (listen(fd, LISTEN_BACKLOG) != 0) {
+    (void)fprintf(stderr, "%s: could not listen on metrics socket: %s\n",
+		  argv_program, strerror(errno));
+    (void)close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+#endif /* HAVE_MMAP && HAVE_SOCKET */
+
+/*
+ * metrics_t *metrics_start
+ *
+ * DESCRIPTION:
+ *
+ * Start listening on an address and fork a process that answers HTTP
+ * requests for the counters in the Prometheus text format.  The
+ * process reads the counters out of shared memory so a scrape never
+ * waits on the data path and the data path never waits on a scrape.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the zeroed counters that the caller updates.
+ *
+ * Failure - NULL if the address was bad or could not be listened on
+ * with an error printed.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Path of a UNIX socket if it contains a '/' otherwise a
+ * [host:]port to listen on with the host defaulting to 127.0.0.1.
+ *
+ * file_names -> Names of the -f output files used as labels.
+ *
+ * file_n -> Number of output files.
+ */
+metrics_t	*metrics_start(const char *address, char **file_names,
+			       const int file_n)
+{
+#if HAVE_MMAP && HAVE_SOCKET
+  metrics_t	*metrics_p;
+  int		listen_fd;
+  pid_t		parent = getpid();
+
+  listen_fd = open_listen(address);
+  if (listen_fd < 0) {
+    return NULL;
+  }
+
+  metrics_size = sizeof(metrics_t) + file_n * sizeof(unsigned long long);
+  metrics_p = (metrics_t *)mmap(NULL, metrics_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (metrics_p == (metrics_t *)MAP_FAILED) {
+    (void)fprintf(stderr, "%s: could not map metrics counters: %s\n",
+		  argv_program, strerror(errno));
+    (void)close(listen_fd);
+    return NULL;
+  }
+
+  /* flush so the child does not write out our buffered output again */
+  (void)fflush(stdout);
+  (void)fflush(stderr);
+  server_pid = fork();
+  if (server_pid < 0) {
+    (void)fprintf(stderr, "%s: could not fork metrics exporter: %s\n",
+		  argv_program, strerror(errno));
+    (void)munmap((void *)metrics_p, metrics_size);
+    (void)close(listen_fd);
+    return NULL;
+  }
+  if (server_pid == 0) {
+    serve(listen_fd, metrics_p, file_names, file_n, parent);
+    _exit(0);
+  }
+
+  (void)close(listen_fd);
+  return metrics_p;
+#else
+  (void)fprintf(stderr, "%s: metrics are not supported on this system\n",
+		argv_program);
+  return NULL;
+#endif
+}
+
+/*
+ * void metrics_stop
+ *
+ * DESCRIPTION:
+ *
+ * Stop the exporter process and release the counters.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * metrics_p -> Counters returned by metrics_start.
+ */
+void	metrics_stop(metrics_t *metrics_p)
+{
+#if HAVE_MMAP && HAVE_SOCKET
+  if (server_pid > 0) {
+    (void)kill(server_pid, SIGTERM);
+    (void)waitpid(server_pid, NULL, 0);
+    server_pid = -1;
+  }
+  if (metrics_p != NULL) {
+    (void)munmap((void *)metrics_p, metrics_size);
+  }
+  if (unix_path != NULL) {
+    (void)unlink(unix_path);
+    free(unix_path);
+    unix_path = NULL;
+  }
+#endif
+}
@@ -0,0 +1,113 @@
+/*
+ * Metrics exporter defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+/*
+ * Counters shared with the exporter process.  Only null's main loop
+ * writes them so the updates are plain relaxed stores which cost no
+ * more than the increments they replace.
+ */
+typedef struct {
+  unsigned long long	me_bytes_in;		/* bytes read */
+  unsigned long long	me_reads;		/* blocks read */
+  unsigned long long	me_writes;		/* blocks written */
+  unsigned long long	me_escapes_added;	/* -w mid escapes added */
+  unsigned long long	me_escapes_removed;	/* -r mid escapes removed */
+  unsigned long long	me_throttle_ns;		/* time sleeping for -t */
+  unsigned long long	me_errors;		/* non-fatal errors */
+  unsigned long long	me_retries;		/* retried -f writes */
+  unsigned long long	me_outputs_dropped;	/* -f files dropped */
+  unsigned long long	me_stdout_bytes;	/* bytes to stdout */
+  unsigned long long	me_file_bytes[];	/* bytes to each -f file */
+} metrics_t;
+
+#if defined(__ATOMIC_RELAXED)
+# define METRICS_LOAD(field)	__atomic_load_n(&(field), __ATOMIC_RELAXED)
+# define METRICS_STORE(field, val) \
+	__atomic_store_n(&(field), (val), __ATOMIC_RELAXED)
+#else
+# define METRICS_LOAD(field)	(*(volatile unsigned long long *)&(field))
+# define METRICS_STORE(field, val) \
+	(*(volatile unsigned long long *)&(field) = (val))
+#endif
+
+/* add to a counter if the metrics are enabled */
+#define METRICS_ADD(metrics_p, field, val)				\
+	do {								\
+	  if ((metrics_p) != NULL) {					\
+	    METRICS_STORE((metrics_p)->field,				\
+			  METRICS_LOAD((metrics_p)->field) + (val));	\
+	  }								\
+	} while (0)
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * metrics_t *metrics_start
+ *
+ * DESCRIPTION:
+ *
+ * Start listening on an address and fork a process that answers HTTP
+ * requests for the counters in the Prometheus text format.  The
+ * process reads the counters out of shared memory so a scrape never
+ * waits on the data path and the data path never waits on a scrape.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the zeroed counters that the caller updates.
+ *
+ * Failure - NULL if the address was bad or could not be listened on
+ * with an error printed.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Path of a UNIX socket if it contains a '/' otherwise a
+ * [host:]port to listen on with the host defaulting to 127.0.0.1.
+ *
+ * file_names -> Names of the -f output files used as labels.
+ *
+ * file_n -> Number of output files.
+ */
+extern
+metrics_t	*metrics_start(const char *address, char **file_names,
+			       const int file_n);
+
+/*
+ * void metrics_stop
+ *
+ * DESCRIPTION:
+ *
+ * Stop the exporter process and release the counters.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * metrics_p -> Counters returned by metrics_start.
+ */
+extern
+void	metrics_stop(metrics_t *metrics_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __METRICS_H__ */
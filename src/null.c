@@ -4,8 +4,13 @@
  * Copyright 2020 by Gray Watson
  */
 
+/* for fallocate, sync_file_range, and their flags */
+#define _GNU_SOURCE
+
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <time.h>
 
@@ -20,79 +25,371 @@
 #if HAVE_UNISTD_H
 # include <unistd.h>
 #endif
+#if HAVE_POLL
+# include <poll.h>
+#endif
 
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include "argv.h"
 #include "compat.h"
+#include "dedup.h"
+#include "fec.h"
+#include "gen.h"
+#include "hist.h"
+#include "iobuf.h"
 #include "md5.h"
+#include "metrics.h"
+#include "ring.h"
+#include "store.h"
+#include "stripe.h"
+#include "sum.h"
+#include "trace.h"
+#include "verify.h"
 #include "version.h"
 
 #define BUFFER_SIZE	100000		/* size of buffer */
 #define WRITES_PER_SEC	10		/* throttle to X writes/sec.  X > 1. */
 #define PASS_CHAR	'p'		/* pass - argument */
 #define STDIN_FD	0		/* stdin file descriptor */
+#define SYNTH_FD	(-1)		/* read from the synthetic input */
+#define STRIPE_FD	(-2)		/* read from the --unstripe files */
 #define BYTE_SIZE_BUF_LEN 80		/* length of the byte-size buffer */
+#define ALL_READ_MEMORY	(1024UL * 1024UL * 1024UL) /* -a mem before spill */
+#define SPARSE_BLOCK	4096		/* size of holes we make with -S */
+#define BENCH_SIZE	(256UL * 1024UL * 1024UL) /* bytes per bench case */
+#define BENCH_PATTERN_SIZE (1024 * 1024) /* size of random bench data */
+#define BENCH_THROTTLE	(64UL * 1024UL * 1024UL) /* bench throttle rate */
+#define BENCH_THROTTLE_SECS 2		/* seconds to run throttle bench */
+#define ROTATE_NEXT_FORMAT "%.*s.%s.next" /* pre-opened next segment */
+#define ROTATE_STAMP_FORMAT "%Y%m%d-%H%M%S" /* --rotate-stamp names */
+
+/* how we open the -f files */
+#define OUTPUT_TRUNC		0	/* truncate an existing file */
+#define OUTPUT_APPEND		1	/* append to an existing file */
+#define OUTPUT_EXCL		2	/* create and fail if it exists */
+
+/* what we do when an -f file fails */
+#define OUTPUT_FATAL		0	/* exit with an error */
+#define OUTPUT_DROP		1	/* stop writing to it and go on */
+#define OUTPUT_RETRY		2	/* retry with backoff then drop */
+#define RETRY_START_MSECS	100	/* first backoff of a retry */
+#define RETRY_MAX_MSECS		5000	/* longest backoff of a retry */
+
+/* stages that we time with -H */
+#define STAGE_READ		0	/* read system call */
+#define STAGE_MD5		1	/* md5_process */
+#define STAGE_READ_PAGE		2	/* read pagination scan */
+#define STAGE_WRITE_PAGE	3	/* write pagination scan and write */
+#define STAGE_STDOUT		4	/* stdout write */
+#define STAGE_SPARSE		5	/* sparse writes to all -f files */
+#define STAGE_THROTTLE		6	/* throttle sleep */
+#define STAGE_N			7
 
 #define PAGINATION_ESC	"null-page-"	/* special pagination string */
 #define PAGINATION_START	's'	/* start character */
 #define PAGINATION_MID		'm'	/* mid character */
 #define PAGINATION_END		'e'	/* end character */
+#define PAGE_IOV_N		64	/* iovecs that we gather */
 
 /* argument vars */
 static	int		read_all_b = ARGV_FALSE; /* read input in before out */
+static	unsigned long	all_read_mem = ALL_READ_MEMORY;	/* -a memory limit */
 static	unsigned long	buf_size = BUFFER_SIZE;	/* size of i/o buffer */
+static	int		bench_b = ARGV_FALSE;	/* run the benchmarks */
+static	int		busy_poll_usecs = 0;	/* spin on input for X */
+static	char		*check_path = NULL;	/* md5sum lines to check */
+static	char		*compare_path = NULL;	/* compare input to file */
+static	int		compare_stop_b = ARGV_FALSE; /* stop at a difference */
+static	unsigned long	coalesce_size = 0;	/* gather reads up to X */
+static	int		coalesce_msecs = 2;	/* for at most X millis */
 static	unsigned long	dot_size = 0;		/* show a dot every X */
-static	int		flush_out_b = ARGV_FALSE; /* flush output to files */
+static	char		*decode_path = NULL;	/* trace file to decode */
+static	int		dedup_b = ARGV_FALSE;	/* dedup statistics */
+static	char		*dedup_dir = NULL;	/* dedup chunk store */
+static	char		*fec_spec = NULL;	/* --fec K,M blocks */
+static	int		flush_out_b = ARGV_FALSE; /* deprecated -F */
+static	char		*gen_type = NULL;	/* generate input type */
+static	char		*gen_pattern = GEN_DEFAULT_PATTERN; /* its pattern */
+static	unsigned long	gen_seed = 0;		/* its random seed */
+static	int		fsync_b = ARGV_FALSE;	/* fsync -f files at close */
 static	int		help_b = ARGV_FALSE;	/* get help */
+static	int		histograms_b = ARGV_FALSE; /* time the stages */
+static	int		huge_pages_b = ARGV_FALSE; /* use huge-page buffers */
+static	int		job_n = 0;		/* --sum-files workers */
 static	int		run_md5_b = ARGV_FALSE;	/* run md5 on data */
+static	char		*metrics_addr = NULL;	/* metrics listen address */
+static	char		*output_errors = "fatal"; /* default -f policy */
+static	char		*output_mode = "trunc";	/* default -f open mode */
+static	int		output_retries = 5;	/* retries of a -f write */
+static	char		*spill_dir = NULL;	/* -a spill directory */
 static	int		non_block_b = ARGV_FALSE; /* don't block on input */
+static	int		numa_local_b = ARGV_FALSE; /* stay on our numa node */
+static	unsigned long	out_block_size = 0;	/* write in X byte blocks */
+static	int		pad_block_b = ARGV_FALSE; /* pad the last block */
 static	int		pass_b = ARGV_FALSE;	/* pass data through */
+static	int		prealloc_b = ARGV_FALSE; /* preallocate -f files */
+static	unsigned long	prealloc_size = 0;	/* bytes to preallocate */
 static	float		rate_every_secs = 0.0;	/* rate every X decimal secs */
 static	int		read_page_b = 0;	/* read pagination info */
+static	int		ring_high_pct = 90;	/* start writing when X% */
+static	int		ring_low_pct = 0;	/* pause writing when X% */
+static	unsigned long	ring_size = 0;		/* input ring buffer size */
+static	char		*rotate_compress = NULL; /* compress old segments */
+static	int		rotate_secs = 0;	/* rotate -f every X secs */
+static	unsigned long	rotate_size = 0;	/* rotate -f every X bytes */
+static	int		rotate_stamp_b = ARGV_FALSE; /* time-stamp segments */
 static	unsigned long	stop_after = 0;		/* stop after X bytes */
+static	int		stripe_parity_b = ARGV_FALSE; /* last -f is parity */
+static	unsigned long	stripe_size = 0;	/* stripe -f files in X */
+static	int		sync_msecs = 0;		/* writeback every X ms */
+static	unsigned long	sync_size = 0;		/* writeback every X bytes */
+static	int		sparse_b = ARGV_FALSE;	/* make sparse out files */
+static	int		sum_files_b = ARGV_FALSE; /* md5sum each input */
 static	unsigned long	throttle_size = 0;	/* throttle bytes/second */
+static	char		*trace_path = NULL;	/* binary -V trace file */
+static	int		unstripe_b = ARGV_FALSE; /* inputs are stripes */
 static	int		verbose_b = ARGV_FALSE;	/* verbose flag */
+static	char		*verify_type = NULL;	/* verify input type */
 static	int		very_verbose_b = ARGV_FALSE; /* very-verbose flag */
 static	int		write_page_b = 0;	/* output pagination info */
-static	char		*input_path = NULL;	/* input file we are reading */
+static	unsigned long	prefetch_size = 0;	/* read-ahead of next input */
+static	argv_array_t	inputs;			/* input files else stdin */
 static	argv_array_t	outfiles;		/* outfiles for read data */
 
+/*
+ * Synthetic input which is the head once, the body repeated until we
+ * have generated the body size, and then the tail once.
+ */
+static	const char		*synth_head = "";	/* start of input */
+static	const char		*synth_body = NULL;	/* repeated middle */
+static	unsigned long		synth_body_len = 0;	/* length of body */
+static	const char		*synth_tail = "";	/* end of input */
+static	unsigned long long	synth_size = 0;		/* total body bytes */
+static	unsigned long long	synth_pos = 0;		/* where we are */
+static	unsigned long long	bench_size = BENCH_SIZE; /* bytes per case */
+
+/* --generate input instead of the head, body, and tail if set */
+static	gen_t		*gen_p = NULL;
+
+/* generator of what --verify expects the input to be if set */
+static	gen_t		*verify_gen_p = NULL;
+
+/* which of the inputs we are reading and the one we prefetched */
+static	int		input_c = 0;		/* current input */
+static	int		next_fd = -1;		/* opened next input */
+
+/* end of the data run that read_sparse is in, reset for each input */
+static	off_t		sparse_data_end = -1;
+
+/* input that we made non-blocking and its flags to put back */
+static	int		nonblock_fd = -1;
+static	int		nonblock_flags = 0;
+
+/* the write in progress ends the output so --pad-block fills it out */
+static	int		last_block_b = 0;
+
+/*
+ * How we open each of the -f files and what we do when they fail.
+ */
+typedef struct {
+  int			ou_mode;	/* OUTPUT_ open mode */
+  int			ou_policy;	/* OUTPUT_ error policy */
+  int			ou_errno;	/* error that dropped it or 0 */
+  unsigned long long	ou_bytes;	/* bytes written to it */
+} output_t;
+static	output_t	*outputs = NULL;
+
+/* time spent syncing the -f files and whether any of them failed */
+static	unsigned long long	sync_ns = 0;
+static	int			output_failed_b = 0;
+
+/*
+ * Rotation state of the -f files.  The next segment of each file is
+ * opened ahead of time so switching to it is just a couple of
+ * renames.
+ */
+static	int		*next_fds = NULL;	/* pre-opened segments */
+static	int		*seg_numbers = NULL;	/* next number of each */
+static	time_t		seg_start = 0;		/* when segment started */
+static	pid_t		*compress_pids = NULL;	/* running compressors */
+static	int		compress_n = 0;		/* number running */
+
+/*
+ * Latency histograms of the stages and of the writes to each of the
+ * output files for -H.
+ */
+static	const char	*stage_names[STAGE_N] = {
+  "read", "md5", "read-page", "write-page", "stdout", "sparse-write",
+  "throttle" };
+static	hist_t			stage_hists[STAGE_N];	/* per stage */
+static	hist_t			*file_hists = NULL;	/* per -f file */
+static	hist_t			forward_hist;		/* read to written */
+static	volatile sig_atomic_t	hist_signal_b = 0;	/* got SIGUSR1 */
+static	volatile sig_atomic_t	trace_signal_b = 0;	/* got SIGUSR2 */
+
+/* counters for --metrics or NULL if it is not enabled */
+static	metrics_t	*metrics_p = NULL;
+
+/* --ring-size buffer of the input or NULL if it is not enabled */
+static	ring_t		*ring_p = NULL;
+
+/*
+ * Striping of the -f files.  Chunk c of the output goes to data file
+ * c % data_n and with parity the xor of each row goes to the last.
+ */
+static	int			striping_b = 0;		/* striping output */
+static	int			stripe_data_n = 0;	/* data files */
+static	unsigned long long	stripe_pos = 0;		/* bytes striped */
+static	char			*stripe_row = NULL;	/* parity of row */
+
+/* the --unstripe files we are reading the stream back from */
+static	stripe_read_t	*stripe_in_p = NULL;
+
+/* --fec encoding of the -w output and decoding of the -r input */
+static	fec_t		*fec_out_p = NULL;
+static	fec_t		*fec_in_p = NULL;
+
+/*
+ * With -w the escapes change the length of stdout so --output-block
+ * can't hold back whole blocks in the input buffer.  Instead the
+ * blocks are gathered from the pagination iovecs and only the bytes
+ * left over after the last whole block are copied here.
+ */
+static	char		*page_carry = NULL;	/* partial stdout block */
+static	unsigned long	page_carry_len = 0;	/* bytes in it */
+static	char		*zero_block = NULL;	/* --pad-block zeros */
+
 static	argv_t	args[] = {
   { 'a',	"all-read",	ARGV_BOOL_INT,			&read_all_b,
     NULL,			"read all input before outputting" },
+  { '\0',	"all-read-memory", ARGV_U_SIZE,			&all_read_mem,
+    "size",			"memory for -a before spilling, 0 no limit" },
   { 'b',	"buffer-size",	ARGV_U_SIZE,			&buf_size,
     "size",			"size of input and output buffer" },
+  { '\0',	"bench",	ARGV_BOOL_INT,			&bench_b,
+    NULL,			"run benchmarks on synthetic input" },
+  { '\0',	"busy-poll",	ARGV_INT,			&busy_poll_usecs,
+    "usecs",			"spin on empty input before blocking" },
+  { '\0',	"check",	ARGV_CHAR_P,			&check_path,
+    "file",			"verify md5sum lines in file" },
+  { '\0',	"coalesce-size", ARGV_U_SIZE,			&coalesce_size,
+    "size",			"gather small reads up to size bytes" },
+  { '\0',	"coalesce-msecs", ARGV_INT,			&coalesce_msecs,
+    "millis",			"longest to wait gathering, default 2" },
+  { '\0',	"compare",	ARGV_CHAR_P,			&compare_path,
+    "file",			"check input is the same as file" },
   { 'd',	"dot-blocks",	ARGV_U_SIZE,			&dot_size,
     "size",			"show a dot each X bytes of input" },
+  { '\0',	"decode-trace",	ARGV_CHAR_P,			&decode_path,
+    "file",			"decode a --trace-file and exit" },
+  { '\0',	"dedup-stats",	ARGV_BOOL_INT,			&dedup_b,
+    NULL,			"report duplicate chunks in the input" },
+  { '\0',	"dedup-store",	ARGV_CHAR_P,			&dedup_dir,
+    "directory",		"write unique chunks and recipe to dir" },
+  { '\0',	"fec",		ARGV_CHAR_P,			&fec_spec,
+    "K,M",			"-w/-r blocks with K data, M parity" },
   { 'f',	"output-file",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&outfiles,
-    "output-file",		"output file(s) to write input" },
+    "output-file",		"output file(s) to write input[,opt]" },
   { 'F',	"flush-output",	ARGV_BOOL_INT,			&flush_out_b,
-    NULL,			"flush output to files" },
+    NULL,			"deprecated, output is not buffered" },
+  { '\0',	"fsync",	ARGV_BOOL_INT,			&fsync_b,
+    NULL,			"fsync -f files before closing them" },
+  { '\0',	"generate",	ARGV_CHAR_P,			&gen_type,
+    "type",			"generate zeros, pattern, or random input" },
   { 'h',	"help",		ARGV_BOOL_INT,			&help_b,
     NULL,			"display help string" },
+  { 'H',	"histograms",	ARGV_BOOL_INT,			&histograms_b,
+    NULL,			"report latency percentiles of stages" },
+  { '\0',	"huge-pages",	ARGV_BOOL_INT,			&huge_pages_b,
+    NULL,			"use huge pages for i/o buffers" },
+  { 'j',	"jobs",		ARGV_INT,			&job_n,
+    "number",			"--sum-files workers, 0 for per-cpu" },
   { 'm',	"md5",		ARGV_BOOL_INT,			&run_md5_b,
     NULL,			"run input bytes through md5" },
   { 'n',	"non-block",	ARGV_BOOL_INT,			&non_block_b,
     NULL,			"don't block on input" },
+  { '\0',	"metrics",	ARGV_CHAR_P,			&metrics_addr,
+    "address",			"serve metrics on socket path or port" },
+  { '\0',	"numa-local",	ARGV_BOOL_INT,			&numa_local_b,
+    NULL,			"keep buffers on local NUMA node" },
+  { '\0',	"output-block",	ARGV_U_SIZE,			&out_block_size,
+    "size",			"write output in fixed size blocks" },
+  { '\0',	"output-errors", ARGV_CHAR_P,			&output_errors,
+    "policy",			"-f errors: fatal, drop, or retry" },
+  { '\0',	"output-mode",	ARGV_CHAR_P,			&output_mode,
+    "mode",			"-f open mode: trunc, append, or excl" },
+  { '\0',	"output-retries", ARGV_INT,			&output_retries,
+    "number",			"times to retry a failing -f write" },
+  { '\0',	"pad-block",	ARGV_BOOL_INT,			&pad_block_b,
+    NULL,			"pad last --output-block with zeros" },
   { PASS_CHAR,	"pass-input",	ARGV_BOOL_INT,			&pass_b,
     NULL,			"write input to standard output" },
+  { '\0',	"pattern",	ARGV_CHAR_P,			&gen_pattern,
+    "string",			"string that --generate pattern repeats" },
+  { '\0',	"preallocate",	ARGV_BOOL_INT,			&prealloc_b,
+    NULL,			"preallocate -f files to the -s size" },
+  { '\0',	"prealloc-size", ARGV_U_SIZE,		&prealloc_size,
+    "size",			"preallocate size bytes of -f files" },
+  { '\0',	"prefetch",	ARGV_U_SIZE,			&prefetch_size,
+    "size",			"read-ahead size of the next input file" },
   { 'r',	"read-pagination", ARGV_BOOL_INT,		&read_page_b,
     NULL,			"read pagination data (use with -w)" },
   { 'R',	"rate-every",	ARGV_FLOAT,			&rate_every_secs,
     "seconds",			"dump rate info every X decimal secs" },
+  { '\0',	"ring-high",	ARGV_INT,			&ring_high_pct,
+    "percent",			"start writing when ring is X% full" },
+  { '\0',	"ring-low",	ARGV_INT,			&ring_low_pct,
+    "percent",			"pause writing when ring is X% full" },
+  { '\0',	"ring-size",	ARGV_U_SIZE,			&ring_size,
+    "size",			"buffer input in a ring of size bytes" },
+  { '\0',	"rotate-compress", ARGV_CHAR_P,			&rotate_compress,
+    "program",			"run program on each rotated segment" },
+  { '\0',	"rotate-secs",	ARGV_INT,			&rotate_secs,
+    "seconds",			"rotate -f files every X seconds" },
+  { '\0',	"rotate-size",	ARGV_U_SIZE,			&rotate_size,
+    "size",			"rotate -f files every X bytes" },
+  { '\0',	"rotate-stamp",	ARGV_BOOL_INT,			&rotate_stamp_b,
+    NULL,			"name rotated segments with time-stamp" },
+  { '\0',	"seed",		ARGV_U_LONG,			&gen_seed,
+    "number",			"seed of --generate random" },
   { 's',	"stop-after",	ARGV_U_SIZE,			&stop_after,
     "size",			"stop after size bytes" },
+  { '\0',	"stop-on-diff",	ARGV_BOOL_INT,			&compare_stop_b,
+    NULL,			"stop at first --compare/--verify diff" },
+  { 'S',	"sparse",	ARGV_BOOL_INT,			&sparse_b,
+    NULL,			"seek over zero blocks in output files" },
+  { '\0',	"spill-dir",	ARGV_CHAR_P,			&spill_dir,
+    "directory",		"where -a spills input past its memory" },
+  { '\0',	"stripe-parity", ARGV_BOOL_INT,			&stripe_parity_b,
+    NULL,			"last stripe file is xor parity" },
+  { '\0',	"stripe-size",	ARGV_U_SIZE,			&stripe_size,
+    "size",			"stripe over -f files in size chunks" },
+  { '\0',	"sync-every",	ARGV_U_SIZE,			&sync_size,
+    "size",			"write back -f files every X bytes" },
+  { '\0',	"sync-msecs",	ARGV_INT,			&sync_msecs,
+    "msecs",			"write back -f files every X millisecs" },
   { 't',	"throttle-size", ARGV_U_SIZE,			&throttle_size,
     "size",			"throttle output to X bytes / sec" },
+  { '\0',	"sum-files",	ARGV_BOOL_INT,			&sum_files_b,
+    NULL,			"print md5sum of each input file" },
+  { '\0',	"trace-file",	ARGV_CHAR_P,			&trace_path,
+    "file",			"write the -V trace to file in binary" },
+  { '\0',	"unstripe",	ARGV_BOOL_INT,			&unstripe_b,
+    NULL,			"read inputs as --stripe-size stripes" },
   { 'v',	"verbose",	ARGV_BOOL_INT,			&verbose_b,
     NULL,			"report on i/o bytes" },
+  { '\0',	"verify",	ARGV_CHAR_P,			&verify_type,
+    "type",			"check input is --generate type stream" },
   { 'V',	"very-verbose",	ARGV_BOOL_INT,		       &very_verbose_b,
     NULL,			"very verbose messages" },
   { 'w',	"write-pagination", ARGV_BOOL_INT,		&write_page_b,
     NULL,			"write paginate data (use with -r)" },
-  { ARGV_MAYBE,	"input-file",	ARGV_CHAR_P,			&input_path,
-    "file",			"file we are reading else stdin" },
+  { ARGV_MAYBE,	"input-file",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&inputs,
+    "file",			"file(s) we are reading else stdin" },
   { ARGV_LAST, NULL, 0, NULL, NULL, NULL }
 };
 
@@ -138,6 +435,183 @@ static	char	*byte_size(const unsigned long size, char *buf, int buf_size)
   return buf;
 }
 
+/*
+ * Return a block of zeros for padding the last --output-block.
+ */
+static	const char	*get_zero_block(void)
+{
+  if (zero_block == NULL) {
+    zero_block = (char *)calloc(1, out_block_size);
+    if (zero_block == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+  }
+  return zero_block;
+}
+
+/*
+ * Write pagination data and escapes to stdout or die trying.
+ */
+static	void	write_stdout_iov(struct iovec *iov, const int iov_n)
+{
+  long	total = 0;
+  int	iov_c;
+  
+  for (iov_c = 0; iov_c < iov_n; iov_c++) {
+    total += iov[iov_c].iov_len;
+  }
+  if (fec_out_p != NULL) {
+    if (fec_write(fec_out_p, STDOUT_FILENO, iov, iov_n) != 0) {
+      (void)fprintf(stderr, "%s: ERROR.  Could not write fec block: %s\n",
+		    argv_program, strerror(errno));
+      exit(1);
+    }
+    return;
+  }
+  if (iobuf_writev(STDOUT_FILENO, iov, iov_n) != total) {
+    (void)fprintf(stderr, "%s: ERROR.  Could not write pagination block: %s\n",
+		  argv_program, strerror(errno));
+    exit(1);
+  }
+}
+
+/*
+ * static void write_page_iov
+ *
+ * DESCRIPTION:
+ *
+ * Write pagination data and escapes to stdout.  With --output-block
+ * each whole block is written with its own writev straight from the
+ * iovecs and what is left over is carried to the next call.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * iov -> Array of buffers that we are writing.
+ *
+ * iov_n -> Number of entries in the array which must not be more
+ * than PAGE_IOV_N.
+ */
+static	void	write_page_iov(struct iovec *iov, const int iov_n)
+{
+  struct iovec	block[PAGE_IOV_N + 1];
+  unsigned long	block_len = 0, off, len;
+  int		block_n = 0, iov_c;
+  
+  if (out_block_size == 0) {
+    write_stdout_iov(iov, iov_n);
+    return;
+  }
+  if (page_carry == NULL) {
+    page_carry = (char *)malloc(out_block_size);
+    if (page_carry == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+  }
+  
+  if (page_carry_len > 0) {
+    block[0].iov_base = page_carry;
+    block[0].iov_len = page_carry_len;
+    block_n = 1;
+    block_len = page_carry_len;
+  }
+  for (iov_c = 0; iov_c < iov_n; iov_c++) {
+    for (off = 0; off < iov[iov_c].iov_len; off += len) {
+      len = iov[iov_c].iov_len - off;
+      if (len > out_block_size - block_len) {
+	len = out_block_size - block_len;
+      }
+      block[block_n].iov_base = (char *)iov[iov_c].iov_base + off;
+      block[block_n].iov_len = len;
+      block_n++;
+      block_len += len;
+      if (block_len == out_block_size) {
+	write_stdout_iov(block, block_n);
+	block_n = 0;
+	block_len = 0;
+      }
+    }
+  }
+  
+  /* the carry can only be the first entry so it is already in place */
+  page_carry_len = 0;
+  for (iov_c = 0; iov_c < block_n; iov_c++) {
+    if (block[iov_c].iov_base != page_carry) {
+      memcpy(page_carry + page_carry_len, block[iov_c].iov_base,
+	     block[iov_c].iov_len);
+    }
+    page_carry_len += block[iov_c].iov_len;
+  }
+}
+
+/*
+ * Write out the partial block left over by write_page_iov at the end
+ * of the output padding it if --pad-block.
+ */
+static	void	flush_page_carry(void)
+{
+  struct iovec	iov[2];
+  int		iov_n = 1;
+  
+  if (page_carry_len == 0) {
+    return;
+  }
+  iov[0].iov_base = page_carry;
+  iov[0].iov_len = page_carry_len;
+  if (pad_block_b) {
+    iov[1].iov_base = (void *)get_zero_block();
+    iov[1].iov_len = out_block_size - page_carry_len;
+    iov_n = 2;
+  }
+  write_stdout_iov(iov, iov_n);
+  page_carry_len = 0;
+}
+
+/*
+ * Write a pagination escape to stdout.
+ */
+static	void	write_page_esc(const char type)
+{
+  char		type_char = type;
+  struct iovec	iov[2];
+  
+  iov[0].iov_base = PAGINATION_ESC;
+  iov[0].iov_len = strlen(PAGINATION_ESC);
+  iov[1].iov_base = &type_char;
+  iov[1].iov_len = 1;
+  write_page_iov(iov, 2);
+}
+
+/*
+ * Write out the data and mid escape iovecs of write_pagination and
+ * then record them in the -V trace so the times are when they went
+ * out.  We save the lengths first since the writev advances them.
+ */
+static	void	write_page_data(struct iovec *iov, const int iov_n,
+				const char *mid_p)
+{
+  unsigned long	lens[PAGE_IOV_N];
+  int		iov_c;
+  
+  for (iov_c = 0; iov_c < iov_n; iov_c++) {
+    lens[iov_c] = (iov[iov_c].iov_base == mid_p ? 0 : iov[iov_c].iov_len);
+  }
+  write_page_iov(iov, iov_n);
+  for (iov_c = 0; iov_c < iov_n; iov_c++) {
+    if (lens[iov_c] == 0) {
+      trace_record(TRACE_PAGE_MID, 0);
+    }
+    else {
+      trace_record(TRACE_PAGE_WRITE, lens[iov_c]);
+    }
+  }
+}
+
 /*
  * static int write_pagination
  *
@@ -163,7 +637,10 @@ static	char	*byte_size(const unsigned long size, char *buf, int buf_size)
 static	int	write_pagination(const char *buf, const int buf_len,
 				 const int last_b)
 {
+  static char	mid_char = PAGINATION_MID;
   const char	*buf_p, *write_p = buf;
+  struct iovec	iov[PAGE_IOV_N];
+  int		iov_c = 0;
   
   int len = strlen(PAGINATION_ESC);
   
@@ -183,18 +660,18 @@ static	int	write_pagination(const char *buf, const int buf_len,
      */
     buf_p += len;
     unsigned int write_len = buf_p - write_p;
-    if (fwrite(write_p, sizeof(char), write_len, stdout) != write_len) {
-      (void)fprintf(stderr,
-		    "%s: ERROR.  Could not write full pagination block.\n",
-		    argv_program);
-      exit(1);
-    }
-    if (very_verbose_b) {
-      (void)fprintf(stderr, " wrote %d paged chars\n", write_len);
-    }
-    (void)fputc(PAGINATION_MID, stdout);
-    if (very_verbose_b) {
-      (void)fprintf(stderr, " wrote mid pagination\n");
+    iov[iov_c].iov_base = (void *)write_p;
+    iov[iov_c].iov_len = write_len;
+    iov_c++;
+    iov[iov_c].iov_base = &mid_char;
+    iov[iov_c].iov_len = 1;
+    iov_c++;
+    METRICS_ADD(metrics_p, me_escapes_added, 1);
+    
+    /* the escapes go out with the data around them */
+    if (iov_c == PAGE_IOV_N) {
+      write_page_data(iov, iov_c, &mid_char);
+      iov_c = 0;
     }
     
     write_p = buf_p;
@@ -213,16 +690,11 @@ static	int	write_pagination(const char *buf, const int buf_len,
   
   len = buf_p - write_p;
   if (len > 0) {
-    if (fwrite(write_p, sizeof(char), len, stdout) != (size_t)len) {
-      (void)fprintf(stderr,
-		    "%s: ERROR.  Could not write partial pagination block.\n",
-		    argv_program);
-      exit(1);
-    }
-    if (very_verbose_b) {
-      (void)fprintf(stderr, " wrote %d paged chars\n", len);
-    }
+    iov[iov_c].iov_base = (void *)write_p;
+    iov[iov_c].iov_len = len;
+    iov_c++;
   }
+  write_page_data(iov, iov_c, &mid_char);
   
   return buf_p - buf;
 }
@@ -259,8 +731,8 @@ static	int	read_pagination(char *buf, const int buf_len,
   
   /* if we've already reached the end then throw away all else */
   if (end_b) {
-    if (very_verbose_b && buf_len > 0) {
-      (void)fprintf(stderr, " trimmed %d paged end chars\n", buf_len);
+    if (buf_len > 0) {
+      trace_record(TRACE_TRIM_AFTER, buf_len);
     }
     *to_write_p = 0;
     return 0;
@@ -293,10 +765,7 @@ static	int	read_pagination(char *buf, const int buf_len,
     memmove(buf, buf + len + 1, buf_len - (len + 1));
     bounds_p -= len + 1;
     
-    if (very_verbose_b) {
-      (void)fprintf(stderr, " trimmed %d bytes of starting pagination\n",
-		    len + 1);
-    }
+    trace_record(TRACE_TRIM_START, len + 1);
     
     start_b = 1;
   }
@@ -316,9 +785,8 @@ static	int	read_pagination(char *buf, const int buf_len,
       /* shift down over the mid sequence */
       memmove(buf_p, buf_p + 1, bounds_p - (buf_p + 1));
       bounds_p--;
-      if (very_verbose_b) {
-	(void)fprintf(stderr, " trimmed 1 byte of mid pagination\n");
-      }
+      METRICS_ADD(metrics_p, me_escapes_removed, 1);
+      trace_record(TRACE_TRIM_MID, 0);
       continue;
     }
     
@@ -326,10 +794,7 @@ static	int	read_pagination(char *buf, const int buf_len,
     if (buf_p[len] == 'e') {
       end_b = 1;
       bounds_p = buf_p;
-      if (very_verbose_b) {
-	(void)fprintf(stderr, " trimmed %d bytes of end pagination\n",
-		      len + 1);
-      }
+      trace_record(TRACE_TRIM_END, len + 1);
       break;
     }
     
@@ -361,170 +826,1753 @@ static	int	read_pagination(char *buf, const int buf_len,
 }
 
 /*
- * Add one timeval into another
+ * static int is_zero
+ *
+ * DESCRIPTION:
+ *
+ * Check to see if a buffer is all zeros.  We check the first bytes
+ * by hand and then compare the buffer against itself shifted by that
+ * many bytes which lets the library memcmp use its vector code.
+ *
+ * RETURNS:
+ *
+ * 1 if the buffer is all zeros else 0.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer we are checking.
+ *
+ * buf_len -> Length of the buffer.
  */
-static	void	timeval_add(struct timeval *from_p, struct timeval *to_p) {
-  to_p->tv_usec += from_p->tv_usec;
-  if (to_p->tv_usec > 1000000) {
-    to_p->tv_sec++;
-    to_p->tv_usec -= 1000000;
+static	int	is_zero(const char *buf, const unsigned long buf_len)
+{
+  unsigned long	check_c, head_len = 16;
+  
+  if (head_len > buf_len) {
+    head_len = buf_len;
   }
-  to_p->tv_sec += from_p->tv_sec;
-}
-
-/*
- * Add one timeval into another
- */
-static	void	timeval_subtract(struct timeval *from_p, struct timeval *to_p) {
-  to_p->tv_sec -= from_p->tv_sec;
-  if (to_p->tv_usec < from_p->tv_usec) {
-    to_p->tv_sec--;
-    to_p->tv_usec += 1000000;
+  for (check_c = 0; check_c < head_len; check_c++) {
+    if (buf[check_c] != '\0') {
+      return 0;
+    }
   }
-  to_p->tv_usec -= from_p->tv_usec;
-}
-
-/*
- * Add one timeval into another
- */
-static	int	check_timeval_after(struct timeval *t1_p, struct timeval *t2_p) {
-  if (t1_p->tv_sec > t2_p->tv_sec) {
-    return 1;
-  } else if (t1_p->tv_sec < t2_p->tv_sec) {
-    return 0;
-  } else if (t1_p->tv_usec > t2_p->tv_usec) {
+  if (buf_len <= head_len) {
     return 1;
-  } else {
-    return 0;
   }
+  return (memcmp(buf, buf + head_len, buf_len - head_len) == 0);
 }
 
-int	main(int argc, char **argv)
+/*
+ * static void output_error
+ *
+ * DESCRIPTION:
+ *
+ * Handle an error on one of the output files according to its
+ * policy.  Either we exit or we close it and carry on writing to the
+ * other outputs without it.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fds <-> Output file descriptors.  The one that failed is set to -1
+ * if we drop it.
+ *
+ * file_c -> Which of the output files failed.
+ *
+ * what -> What we were trying to do to it.
+ *
+ * error -> Errno of the failure.
+ */
+static	void	output_error(int *fds, const int file_c,
+			     const char *what, const int error)
 {
-  unsigned long long	write_bytes_c = 0, last_write_c = 0;
-  unsigned long		read_c = 0;
-  unsigned long		to_write, min_write = 0;
-  unsigned long		write_size, write_c = 0;
-  int			eof_b = 0, open_out_b = 1;
-  FILE			**streams = NULL;
-  struct timeval	next_rate, rate_every;
-
-  argv_help_string = "Null utility.  Also try --usage.";
-  argv_version_string = NULL_VERSION_STRING;
+  const char	*path = ARGV_ARRAY_ENTRY(outfiles, char *, file_c);
   
-  argv_process(args, argc, argv);
-  if (very_verbose_b) {
-    verbose_b = 1;
+  if (outputs[file_c].ou_policy == OUTPUT_FATAL) {
+    (void)fprintf(stderr, "%s: ERROR.  Could not %s %s: %s\n",
+		  argv_program, what, path, strerror(error));
+    exit(1);
   }
   
-  if (rate_every_secs > 0.0) {
-    rate_every.tv_sec = (int)rate_every_secs;
-    rate_every.tv_usec = ((float)rate_every_secs - (float)rate_every.tv_sec) * 1000000.0;
-    gettimeofday(&next_rate, NULL);
-    timeval_add(&rate_every, &next_rate);
+  (void)fprintf(stderr, "%s: could not %s %s so dropping it: %s\n",
+		argv_program, what, path, strerror(error));
+  METRICS_ADD(metrics_p, me_errors, 1);
+  METRICS_ADD(metrics_p, me_outputs_dropped, 1);
+  outputs[file_c].ou_errno = error;
+  output_failed_b = 1;
+  if (fds[file_c] >= 0) {
+    (void)close(fds[file_c]);
+    fds[file_c] = -1;
   }
+}
 
-  if (help_b) {
-    (void)fprintf(stderr, "Null Utility: http://256.com/sources/null/\n");
-    (void)fprintf(stderr,
-                  "  This utility combines the functionality of /dev/null,\n");
-    (void)fprintf(stderr,
-                  "  tee, and md5sum with additional features.\n");
-    (void)fprintf(stderr,
-		  "  For a list of command-line options enter: %s --usage\n",
-                  argv_argv[0]);
-    exit(0);
-  }
+/*
+ * Write a buffer to a file descriptor one --output-block at a time
+ * since each write to a tape device makes one block on the tape.  Only
+ * the last write of the output is padded.  Returns the number of bytes
+ * written like iobuf_write.
+ */
+static	long	write_blocks(const int fd, const char *buf,
+			     const unsigned long buf_len)
+{
+  unsigned long	written = 0, len;
+  long		ret;
   
-  if (write_page_b && (! pass_b)) {
-    (void)fprintf(stderr,
-		  "%s: disabling write pagination since pass data flag (-%c) "
-		  "disabled\n",
-		  argv_program, PASS_CHAR);
-    write_page_b = 0;
-  }
-
-  int input_fd;
-  if (input_path == NULL) {
-    input_fd = STDIN_FD;
+  if (out_block_size == 0) {
+    return iobuf_write(fd, buf, buf_len);
   }
-  else {
-    input_fd = open(input_path, O_RDONLY, 0);
-    if (input_fd < 0) {
-      (void)fprintf(stderr, "%s: cannot open(%s): %s\n", 
-		    argv_program, input_path, strerror(errno));
-      exit(1);
+  while (written < buf_len) {
+    len = buf_len - written;
+    if (len > out_block_size) {
+      len = out_block_size;
+    }
+    if (len < out_block_size && pad_block_b && last_block_b) {
+      /* the end of the output is short so fill out the block */
+      struct iovec	iov[2];
+      iov[0].iov_base = (void *)(buf + written);
+      iov[0].iov_len = len;
+      iov[1].iov_base = (void *)get_zero_block();
+      iov[1].iov_len = out_block_size - len;
+      ret = iobuf_writev(fd, iov, 2);
+      written += (ret < (long)len ? ret : (long)len);
+      break;
+    }
+    ret = iobuf_write(fd, buf + written, len);
+    written += ret;
+    if (ret < (long)len) {
+      break;
     }
   }
+  return written;
+}
+
+/*
+ * static int write_output
+ *
+ * DESCRIPTION:
+ *
+ * Write a buffer to one of the output files.  With the retry policy
+ * a failed write is tried again after backing off for longer each
+ * time in case the problem goes away, like a full disk that gets
+ * cleaned up.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the output was dropped.
+ *
+ * ARGUMENTS:
+ *
+ * fds <-> Output file descriptors.  The one that failed is set to -1
+ * if we drop it.
+ *
+ * file_c -> Which of the output files we are writing to.
+ *
+ * buf -> Buffer we are writing.
+ *
+ * buf_len -> Length of the buffer.
+ */
+static	int	write_output(int *fds, const int file_c, const char *buf,
+			     const unsigned long buf_len)
+{
+  unsigned long	msecs = RETRY_START_MSECS;
+  int		retry_c;
   
-  /* make stdin non-blocking */
-  if (non_block_b) {
-    (void)fcntl(input_fd, F_SETFL, fcntl(input_fd, F_GETFL, 0) | O_NONBLOCK);
+  unsigned long written = write_blocks(fds[file_c], buf, buf_len);
+  int error = errno;
+  if (outputs[file_c].ou_policy == OUTPUT_RETRY) {
+    for (retry_c = 0; written < buf_len && retry_c < output_retries;
+	 retry_c++) {
+      struct timeval timeout;
+      timeout.tv_sec = msecs / 1000;
+      timeout.tv_usec = (msecs % 1000) * 1000;
+      (void)select(0, NULL, NULL, NULL, &timeout);
+      msecs *= 2;
+      if (msecs > RETRY_MAX_MSECS) {
+	msecs = RETRY_MAX_MSECS;
+      }
+      METRICS_ADD(metrics_p, me_retries, 1);
+      
+      written += write_blocks(fds[file_c], buf + written, buf_len - written);
+      error = errno;
+    }
   }
-  
-  /* open output paths if needed -- we add one to accomodate stdout */
-  if (outfiles.aa_entry_n == 0) {
-    streams = NULL;
+  if (written < buf_len) {
+    output_error(fds, file_c, "write to", error);
+    return -1;
   }
-  else {
-    streams = (FILE **)calloc(outfiles.aa_entry_n, sizeof(FILE *));
-    if (streams == NULL) {
-      perror("malloc");
-      exit(1);
+  return 0;
+}
+
+/*
+ * static unsigned long write_sparse
+ *
+ * DESCRIPTION:
+ *
+ * Write a buffer to the output files seeking over any aligned blocks
+ * of zeros instead of writing them so the files end up sparse.  The
+ * files need to be truncated to their full size when they are closed
+ * in case they end with a hole.
+ *
+ * RETURNS:
+ *
+ * Number of bytes that we seeked over.
+ *
+ * ARGUMENTS:
+ *
+ * fds <-> Output file descriptors that we are writing to.  Entries
+ * of -1 are skipped and any that we drop are set to -1.
+ *
+ * fd_n -> Number of output file descriptors.
+ *
+ * buf -> Buffer we are writing.
+ *
+ * buf_len -> Length of the buffer we are writing.
+ *
+ * offset -> Offset in the output files where the buffer starts.
+ */
+static	unsigned long	write_sparse(int *fds, const int fd_n,
+				     const char *buf,
+				     const unsigned long buf_len,
+				     const unsigned long long offset)
+{
+  const char	*buf_p = buf, *run_p = buf, *bounds_p = buf + buf_len;
+  unsigned long	skip_c = 0;
+  int		fd_c;
+  
+  while (buf_p < bounds_p) {
+    
+    /*
+     * Chunks are aligned to the blocks of the output file.  Partial
+     * blocks at the ends of the buffer are seeked over as well so they
+     * join up with the zeros of the next or previous write.
+     */
+    unsigned long chunk = SPARSE_BLOCK
+      - (offset + (buf_p - buf)) % SPARSE_BLOCK;
+    if (chunk > (unsigned long)(bounds_p - buf_p)) {
+      chunk = bounds_p - buf_p;
+    }
+    if (! is_zero(buf_p, chunk)) {
+      buf_p += chunk;
+      continue;
+    }
+    
+    /* find the end of the zero blocks */
+    const char *zero_p = buf_p;
+    for (buf_p += chunk; buf_p < bounds_p; buf_p += chunk) {
+      chunk = SPARSE_BLOCK;
+      if (chunk > (unsigned long)(bounds_p - buf_p)) {
+	chunk = bounds_p - buf_p;
+      }
+      if (! is_zero(buf_p, chunk)) {
+	break;
+      }
+    }
+    
+    for (fd_c = 0; fd_c < fd_n; fd_c++) {
+      if (fds[fd_c] < 0) {
+	continue;
+      }
+      if (zero_p > run_p
+	  && write_output(fds, fd_c, run_p, zero_p - run_p) != 0) {
+	continue;
+      }
+      if (lseek(fds[fd_c], buf_p - zero_p, SEEK_CUR) < 0) {
+	output_error(fds, fd_c, "seek in", errno);
+      }
+    }
+    skip_c += buf_p - zero_p;
+    run_p = buf_p;
+  }
+  
+  /* write the remaining non-zero run */
+  for (fd_c = 0; fd_c < fd_n; fd_c++) {
+    if (fds[fd_c] >= 0 && bounds_p > run_p) {
+      (void)write_output(fds, fd_c, run_p, bounds_p - run_p);
+    }
+  }
+  
+  return skip_c;
+}
+
+/*
+ * static int read_sparse
+ *
+ * DESCRIPTION:
+ *
+ * Read from a regular file using SEEK_DATA and SEEK_HOLE to find its
+ * holes.  Holes are returned as zeros without reading them from the
+ * disk.
+ *
+ * RETURNS:
+ *
+ * Number of bytes read, 0 on EOF, or -1 on error.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are reading from.
+ *
+ * buf <- Buffer that we are reading into.
+ *
+ * size -> Maximum number of bytes to read.
+ */
+static	int	read_sparse(const int fd, char *buf, const unsigned long size)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  unsigned long	read_size = size;
+  
+  off_t pos = lseek(fd, 0, SEEK_CUR);
+  if (pos >= 0 && pos >= sparse_data_end) {
+    off_t data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0 && errno == ENXIO) {
+      /* we are in a hole that runs to the end of the file or at the EOF */
+      struct stat statbuf;
+      if (fstat(fd, &statbuf) == 0) {
+	data = statbuf.st_size;
+      }
+    }
+    if (data > pos) {
+      /* in a hole so return zeros instead of reading */
+      if ((unsigned long)(data - pos) < read_size) {
+	read_size = data - pos;
+      }
+      memset(buf, 0, read_size);
+      (void)lseek(fd, pos + read_size, SEEK_SET);
+      return read_size;
+    }
+    if (data == pos) {
+      sparse_data_end = lseek(fd, pos, SEEK_HOLE);
+    }
+    /* go back to where we were if anything failed */
+    (void)lseek(fd, pos, SEEK_SET);
+  }
+  
+  /* don't read past the end of the data into the next hole */
+  if (pos >= 0 && sparse_data_end > pos
+      && (unsigned long)(sparse_data_end - pos) < read_size) {
+    read_size = sparse_data_end - pos;
+  }
+  return read(fd, buf, read_size);
+#else
+  return read(fd, buf, size);
+#endif
+}
+
+/*
+ * Copy from a string into the buffer starting at an offset.
+ */
+static	unsigned long	synth_copy(const char *str, const unsigned long str_len,
+				   const unsigned long long offset, char *buf,
+				   const unsigned long size)
+{
+  unsigned long	len = str_len - offset;
+  
+  if (len > size) {
+    len = size;
+  }
+  memcpy(buf, str + offset, len);
+  return len;
+}
+
+/*
+ * static int read_synth
+ *
+ * DESCRIPTION:
+ *
+ * Read from our synthetic input or the --generate generator instead
+ * of a file descriptor.
+ *
+ * RETURNS:
+ *
+ * Number of bytes that were "read", 0 on the EOF.
+ *
+ * ARGUMENTS:
+ *
+ * buf <- Buffer that we are reading into.
+ *
+ * size -> Maximum number of bytes to read.
+ */
+static	int	read_synth(char *buf, const unsigned long size)
+{
+  unsigned long long	head_len = strlen(synth_head);
+  unsigned long long	tail_len = strlen(synth_tail);
+  unsigned long long	pos = synth_pos;
+  unsigned long		len;
+  
+  if (gen_p != NULL) {
+    /* the generator goes on until -s stops us */
+    gen_fill(gen_p, buf, size);
+    return size;
+  }
+  
+  if (pos < head_len) {
+    len = synth_copy(synth_head, head_len, pos, buf, size);
+  }
+  else if (pos < head_len + synth_size) {
+    pos -= head_len;
+    len = synth_copy(synth_body, synth_body_len, pos % synth_body_len,
+		     buf, size);
+    if (len > synth_size - pos) {
+      len = synth_size - pos;
+    }
+  }
+  else if (pos < head_len + synth_size + tail_len) {
+    len = synth_copy(synth_tail, tail_len, pos - head_len - synth_size,
+		     buf, size);
+  }
+  else {
+    return 0;
+  }
+  
+  synth_pos += len;
+  return len;
+}
+
+/*
+ * Add one timeval into another
+ */
+static	void	timeval_add(struct timeval *from_p, struct timeval *to_p) {
+  to_p->tv_usec += from_p->tv_usec;
+  if (to_p->tv_usec > 1000000) {
+    to_p->tv_sec++;
+    to_p->tv_usec -= 1000000;
+  }
+  to_p->tv_sec += from_p->tv_sec;
+}
+
+/*
+ * Add one timeval into another
+ */
+static	void	timeval_subtract(struct timeval *from_p, struct timeval *to_p) {
+  to_p->tv_sec -= from_p->tv_sec;
+  if (to_p->tv_usec < from_p->tv_usec) {
+    to_p->tv_sec--;
+    to_p->tv_usec += 1000000;
+  }
+  to_p->tv_usec -= from_p->tv_usec;
+}
+
+/*
+ * Add one timeval into another
+ */
+static	int	check_timeval_after(struct timeval *t1_p, struct timeval *t2_p) {
+  if (t1_p->tv_sec > t2_p->tv_sec) {
+    return 1;
+  } else if (t1_p->tv_sec < t2_p->tv_sec) {
+    return 0;
+  } else if (t1_p->tv_usec > t2_p->tv_usec) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+/*
+ * static void store_all
+ *
+ * DESCRIPTION:
+ *
+ * Move the processed bytes from the front of the buffer into the
+ * read-all store and shift down what remains.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are saving into.
+ *
+ * buf -> Buffer with the bytes to store at the front.
+ *
+ * buf_len_p <-> Pointer to the number of bytes in the buffer which
+ * will be reduced by the number of bytes that we stored.
+ *
+ * len -> Number of bytes at the front of the buffer to store.
+ */
+static	void	store_all(store_t *store_p, char *buf,
+			  unsigned long *buf_len_p, const unsigned long len)
+{
+  if (len == 0) {
+    return;
+  }
+  if (store_write(store_p, buf, len) != 0) {
+    (void)fprintf(stderr, "%s: could not store input: %s\n",
+		  argv_program, strerror(errno));
+    exit(1);
+  }
+  if (*buf_len_p > len) {
+    memmove(buf, buf + len, *buf_len_p - len);
+  }
+  *buf_len_p -= len;
+}
+
+/*
+ * Return a time-stamp for stage_end if we are timing the stages.
+ */
+static	unsigned long long	stage_start(void)
+{
+  if (histograms_b) {
+    return hist_now();
+  }
+  else {
+    return 0;
+  }
+}
+
+/*
+ * Record the time since stage_start into a histogram.
+ */
+static	void	stage_end(hist_t *hist_p, const unsigned long long start)
+{
+  if (histograms_b) {
+    hist_record(hist_p, hist_now() - start);
+  }
+}
+
+/*
+ * Write the parity of the current row to the parity file and start
+ * the next row.
+ */
+static	void	write_stripe_parity(int *fds)
+{
+  int	parity_c = stripe_data_n;
+  
+  if (fds[parity_c] >= 0
+      && write_output(fds, parity_c, stripe_row, stripe_size) == 0) {
+    METRICS_ADD(metrics_p, me_file_bytes[parity_c], stripe_size);
+    outputs[parity_c].ou_bytes += stripe_size;
+  }
+  memset(stripe_row, 0, stripe_size);
+}
+
+/*
+ * static void write_stripes
+ *
+ * DESCRIPTION:
+ *
+ * Write a buffer round-robin across the -f files in --stripe-size
+ * chunks instead of writing all of it to each file.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fds -> Array of output file descriptors.
+ *
+ * buf -> Buffer we are writing.
+ *
+ * buf_len -> Length of the buffer.
+ */
+static	void	write_stripes(int *fds, const char *buf,
+			      const unsigned long buf_len)
+{
+  unsigned long	done = 0, len, in_chunk;
+  int		file_c;
+  
+  while (done < buf_len) {
+    file_c = (stripe_pos / stripe_size) % stripe_data_n;
+    in_chunk = stripe_pos % stripe_size;
+    len = stripe_size - in_chunk;
+    if (len > buf_len - done) {
+      len = buf_len - done;
+    }
+    
+    if (fds[file_c] >= 0) {
+      unsigned long long file_start = stage_start();
+      if (write_output(fds, file_c, buf + done, len) == 0) {
+	METRICS_ADD(metrics_p, me_file_bytes[file_c], len);
+	outputs[file_c].ou_bytes += len;
+      }
+      if (file_hists != NULL) {
+	stage_end(&file_hists[file_c], file_start);
+      }
+    }
+    if (stripe_row != NULL) {
+      stripe_xor(stripe_row + in_chunk, buf + done, len);
+    }
+    
+    stripe_pos += len;
+    done += len;
+    if (stripe_row != NULL && file_c == stripe_data_n - 1
+	&& in_chunk + len == stripe_size) {
+      write_stripe_parity(fds);
+    }
+  }
+}
+
+/*
+ * Write out the parity of the last partial row and the length of the
+ * stream at the end of the parity file.
+ */
+static	void	finish_stripes(int *fds)
+{
+  unsigned char	trailer[STRIPE_TRAILER_SIZE];
+  int		byte_c, parity_c = stripe_data_n;
+  
+  if (stripe_row == NULL || fds[parity_c] < 0) {
+    return;
+  }
+  if (stripe_pos % (stripe_size * stripe_data_n) != 0) {
+    write_stripe_parity(fds);
+  }
+  for (byte_c = STRIPE_TRAILER_SIZE - 1; byte_c >= 0; byte_c--) {
+    trailer[byte_c] = (stripe_pos >> ((STRIPE_TRAILER_SIZE - 1 - byte_c) * 8))
+      & 0xFF;
+  }
+  (void)write_output(fds, parity_c, (char *)trailer, sizeof(trailer));
+}
+
+/*
+ * Print the percentiles of a histogram on one line.
+ */
+static	void	print_hist(const char *label, const hist_t *hist_p)
+{
+  char	p50[HIST_DURATION_LEN], p99[HIST_DURATION_LEN];
+  char	p999[HIST_DURATION_LEN], max[HIST_DURATION_LEN];
+  
+  if (hist_p->hi_total == 0) {
+    return;
+  }
+  (void)fprintf(stderr, "%s: %-16s n=%llu p50=%s p99=%s p999=%s max=%s\n",
+		argv_program, label, hist_p->hi_total,
+		hist_duration(hist_percentile(hist_p, 50.0), p50, sizeof(p50)),
+		hist_duration(hist_percentile(hist_p, 99.0), p99, sizeof(p99)),
+		hist_duration(hist_percentile(hist_p, 99.9), p999,
+			      sizeof(p999)),
+		hist_duration(hist_p->hi_max, max, sizeof(max)));
+}
+
+/*
+ * static void print_histograms
+ *
+ * DESCRIPTION:
+ *
+ * Print the latency percentiles of the stages and the output files
+ * that have recorded anything.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	void	print_histograms(void)
+{
+  char	label[64];
+  int	stage_c, file_c;
+  
+  for (stage_c = 0; stage_c < STAGE_N; stage_c++) {
+    print_hist(stage_names[stage_c], &stage_hists[stage_c]);
+  }
+  print_hist("forward", &forward_hist);
+  if (file_hists == NULL) {
+    return;
+  }
+  for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+    loc_snprintf(label, sizeof(label), "file %s",
+		 ARGV_ARRAY_ENTRY(outfiles, char *, file_c));
+    print_hist(label, &file_hists[file_c]);
+  }
+}
+
+/*
+ * Note that we have been asked to print the histograms or dump the
+ * trace.  The loop does the work since stdio is not safe in a signal
+ * handler.
+ */
+static	void	dump_signal(int sig)
+{
+  if (sig == SIGUSR1) {
+    hist_signal_b = 1;
+  }
+  else {
+    trace_signal_b = 1;
+  }
+}
+
+/*
+ * Install our handler for a signal.  We restart the system calls so
+ * a blocked read does not fail but the dump then happens after it
+ * returns.
+ */
+static	void	dump_signal_init(const int sig)
+{
+#if HAVE_SIGACTION
+  struct sigaction	sa;
+  
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = dump_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  (void)sigaction(sig, &sa, NULL);
+#else
+  (void)signal(sig, dump_signal);
+#endif
+}
+
+/*
+ * Dump the trace from atexit so we see what led up to an error.
+ */
+static	void	trace_exit(void)
+{
+  (void)trace_dump();
+}
+
+/*
+ * Stop the --metrics exporter from atexit so it doesn't outlive us or
+ * leave its socket behind when we exit on an error.
+ */
+static	void	metrics_exit(void)
+{
+  if (metrics_p != NULL) {
+    metrics_stop(metrics_p);
+    metrics_p = NULL;
+  }
+}
+
+/*
+ * Return the name of an input for messages.
+ */
+static	const char	*input_name(const int which)
+{
+  if (stripe_in_p != NULL) {
+    return "stripe files";
+  }
+  if (which >= inputs.aa_entry_n) {
+    return "stdin";
+  }
+  return ARGV_ARRAY_ENTRY(inputs, char *, which);
+}
+
+/*
+ * static int open_input
+ *
+ * DESCRIPTION:
+ *
+ * Open one of our input files or use the descriptor that we opened
+ * when we prefetched it.
+ *
+ * RETURNS:
+ *
+ * File descriptor of the input.  We exit if it cannot be opened.
+ *
+ * ARGUMENTS:
+ *
+ * which -> Index of the input in the inputs array.
+ */
+static	int	open_input(const int which)
+{
+  int	fd;
+  
+  if (which >= inputs.aa_entry_n) {
+    return STDIN_FD;
+  }
+  if (which == input_c + 1 && next_fd >= 0) {
+    fd = next_fd;
+    next_fd = -1;
+    return fd;
+  }
+  
+  fd = open(ARGV_ARRAY_ENTRY(inputs, char *, which), O_RDONLY, 0);
+  if (fd < 0) {
+    (void)fprintf(stderr, "%s: cannot open(%s): %s\n", 
+		  argv_program, input_name(which), strerror(errno));
+    exit(1);
+  }
+  return fd;
+}
+
+/*
+ * static int start_input
+ *
+ * DESCRIPTION:
+ *
+ * Get ready to read from an input.  If we are prefetching then the
+ * next input is opened and the kernel is asked to start reading it
+ * in so there is no gap when we get to it.
+ *
+ * RETURNS:
+ *
+ * 1 if we should look for holes in the input with read_sparse else 0.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor of the input that we are starting.
+ */
+static	int	start_input(const int fd)
+{
+  struct stat	statbuf;
+  
+  sparse_data_end = -1;
+  
+  /*
+   * Make the input non-blocking which we also need to spin on it.  The
+   * flags are shared with whoever gave us the descriptor so we save
+   * them to put back when we are done.
+   */
+  if (non_block_b || busy_poll_usecs > 0 || ring_p != NULL) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+      nonblock_fd = fd;
+      nonblock_flags = flags;
+      (void)fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+  }
+  
+  if (prefetch_size > 0 && next_fd < 0 && input_c + 1 < inputs.aa_entry_n) {
+    /* if this fails we will report it when we get to the input */
+    next_fd = open(ARGV_ARRAY_ENTRY(inputs, char *, input_c + 1),
+		   O_RDONLY, 0);
+#if HAVE_POSIX_FADVISE
+    if (next_fd >= 0) {
+      (void)posix_fadvise(next_fd, 0, prefetch_size, POSIX_FADV_WILLNEED);
+    }
+#endif
+  }
+  
+  /* we can only look for holes in the input if it is a regular file */
+  if (sparse_b && fstat(fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode)) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Put back the flags of an input that start_input made non-blocking.
+ * This is also called from atexit so a tty or a descriptor that we
+ * inherited isn't left non-blocking when we exit on an error.
+ */
+static	void	finish_input(void)
+{
+  if (nonblock_fd >= 0) {
+    (void)fcntl(nonblock_fd, F_SETFL, nonblock_flags);
+    nonblock_fd = -1;
+  }
+}
+
+/*
+ * Translate an open mode name into its OUTPUT_ value or -1 if it is
+ * not one that we know.
+ */
+static	int	mode_value(const char *name)
+{
+  if (strcmp(name, "trunc") == 0) {
+    return OUTPUT_TRUNC;
+  }
+  else if (strcmp(name, "append") == 0) {
+    return OUTPUT_APPEND;
+  }
+  else if (strcmp(name, "excl") == 0) {
+    return OUTPUT_EXCL;
+  }
+  else {
+    return -1;
+  }
+}
+
+/*
+ * Translate an error policy name into its OUTPUT_ value or -1 if it
+ * is not one that we know.
+ */
+static	int	policy_value(const char *name)
+{
+  if (strcmp(name, "fatal") == 0) {
+    return OUTPUT_FATAL;
+  }
+  else if (strcmp(name, "drop") == 0) {
+    return OUTPUT_DROP;
+  }
+  else if (strcmp(name, "retry") == 0) {
+    return OUTPUT_RETRY;
+  }
+  else {
+    return -1;
+  }
+}
+
+/*
+ * static void parse_outputs
+ *
+ * DESCRIPTION:
+ *
+ * Work out the open mode and error policy of each of the -f files.
+ * A file can be given as path,opt,... to override the --output-mode
+ * and --output-errors defaults in which case we cut the options off
+ * of the path.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	void	parse_outputs(void)
+{
+  int	file_c;
+  
+  int def_mode = mode_value(output_mode);
+  if (def_mode < 0) {
+    (void)fprintf(stderr, "%s: unknown --output-mode: %s\n",
+		  argv_program, output_mode);
+    exit(1);
+  }
+  int def_policy = policy_value(output_errors);
+  if (def_policy < 0) {
+    (void)fprintf(stderr, "%s: unknown --output-errors: %s\n",
+		  argv_program, output_errors);
+    exit(1);
+  }
+  if (outfiles.aa_entry_n == 0) {
+    return;
+  }
+  
+  outputs = (output_t *)calloc(outfiles.aa_entry_n, sizeof(output_t));
+  if (outputs == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+    char *path = ARGV_ARRAY_ENTRY(outfiles, char *, file_c);
+    outputs[file_c].ou_mode = def_mode;
+    outputs[file_c].ou_policy = def_policy;
+    
+    /* a comma that isn't followed by an option is just part of the path */
+    char *comma_p;
+    while ((comma_p = strrchr(path, ',')) != NULL) {
+      int val;
+      if ((val = mode_value(comma_p + 1)) >= 0) {
+	outputs[file_c].ou_mode = val;
+      }
+      else if ((val = policy_value(comma_p + 1)) >= 0) {
+	outputs[file_c].ou_policy = val;
+      }
+      else {
+	break;
+      }
+      *comma_p = '\0';
+    }
+  }
+}
+
+/*
+ * static int open_output
+ *
+ * DESCRIPTION:
+ *
+ * Open an output file in one of the OUTPUT_ modes and preallocate
+ * the space that we expect to write to it if requested so the file
+ * system can lay it out contiguously.
+ *
+ * RETURNS:
+ *
+ * Success - File descriptor that we write to.
+ *
+ * Failure - -1 with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file that we are opening.
+ *
+ * mode -> OUTPUT_ mode that we open it in.
+ */
+static	int	open_output(const char *path, const int mode)
+{
+  int	flags = O_WRONLY | O_CREAT;
+  
+  if (mode == OUTPUT_EXCL) {
+    flags |= O_EXCL;
+  }
+  else if (mode == OUTPUT_TRUNC) {
+    flags |= O_TRUNC;
+  }
+  else if (! sparse_b) {
+    /* -S needs to seek past the end so it appends with a seek below */
+    flags |= O_APPEND;
+  }
+  
+  int fd = open(path, flags, 0666);
+  if (fd < 0) {
+    return -1;
+  }
+  off_t offset = 0;
+  if (mode == OUTPUT_APPEND) {
+    offset = lseek(fd, 0, SEEK_END);
+  }
+  
+  unsigned long long size = (prealloc_size > 0 ? prealloc_size : stop_after);
+  if (rotate_size > 0 && size > rotate_size) {
+    size = rotate_size;
+  }
+  if ((prealloc_b || prealloc_size > 0) && size > 0 && offset >= 0) {
+    /*
+     * This is only a hint so we don't mind if the file is a device or
+     * the file system doesn't support it.  We keep the size so a
+     * reader doesn't see the allocated space as data.  Without a way
+     * to do that, like posix_fallocate which extends the file, we
+     * don't preallocate at all.
+     */
+    int ret;
+#if HAVE_FALLOCATE && defined(FALLOC_FL_KEEP_SIZE)
+    ret = 0;
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, size) != 0) {
+      ret = errno;
+    }
+#else
+    ret = EOPNOTSUPP;
+#endif
+    if (ret != 0 && verbose_b) {
+      (void)fprintf(stderr, "%s: could not preallocate %s: %s\n",
+		    argv_program, path, strerror(ret));
+    }
+  }
+  
+  return fd;
+}
+
+/*
+ * static void close_output
+ *
+ * DESCRIPTION:
+ *
+ * Close an output file.  If we seeked past its end with -S or
+ * preallocated past what we wrote then we truncate it to where we
+ * are.  With --fsync we make sure that it is on the disk before we
+ * close it.  If the sync or close fails we note it so we can exit
+ * with an error.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> Output file descriptor that we are closing.
+ */
+static	void	close_output(const int fd)
+{
+  int	failed_b = 0;
+  
+  if (sparse_b || prealloc_b || prealloc_size > 0) {
+    off_t end = lseek(fd, 0, SEEK_CUR);
+    if (end < 0 || ftruncate(fd, end) != 0) {
+      (void)fprintf(stderr, "%s: could not truncate output file: %s\n",
+		    argv_program, strerror(errno));
+      METRICS_ADD(metrics_p, me_errors, 1);
+    }
+  }
+  
+  if (fsync_b) {
+    unsigned long long sync_start = hist_now();
+    /* EINVAL is a pipe or device that can't be synced */
+    if (fsync(fd) != 0 && errno != EINVAL) {
+      (void)fprintf(stderr, "%s: could not fsync output file: %s\n",
+		    argv_program, strerror(errno));
+      failed_b = 1;
+    }
+    sync_ns += hist_now() - sync_start;
+  }
+  
+  if (close(fd) != 0) {
+    (void)fprintf(stderr, "%s: could not close output file: %s\n",
+		  argv_program, strerror(errno));
+    failed_b = 1;
+  }
+  if (failed_b) {
+    METRICS_ADD(metrics_p, me_errors, 1);
+    output_failed_b = 1;
+  }
+}
+
+/*
+ * static void sync_parent
+ *
+ * DESCRIPTION:
+ *
+ * With --fsync, sync the directory of an output file that we created
+ * or renamed so its name is on the disk as well as its data.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file whose directory we are syncing.
+ */
+static	void	sync_parent(const char *path)
+{
+  char		dir[1024];
+  const char	*slash_p;
+  int		fd, flags = O_RDONLY;
+  
+  if (! fsync_b) {
+    return;
+  }
+  slash_p = strrchr(path, '/');
+  if (slash_p == NULL) {
+    loc_snprintf(dir, sizeof(dir), ".");
+  }
+  else if (slash_p == path) {
+    loc_snprintf(dir, sizeof(dir), "/");
+  }
+  else {
+    loc_snprintf(dir, sizeof(dir), "%.*s", (int)(slash_p - path), path);
+  }
+  
+#ifdef O_DIRECTORY
+  flags |= O_DIRECTORY;
+#endif
+  unsigned long long sync_start = hist_now();
+  fd = open(dir, flags, 0);
+  /* EINVAL is a file system that can't sync directories */
+  if (fd < 0 || (fsync(fd) != 0 && errno != EINVAL)) {
+    (void)fprintf(stderr, "%s: could not fsync directory %s: %s\n",
+		  argv_program, dir, strerror(errno));
+    METRICS_ADD(metrics_p, me_errors, 1);
+    output_failed_b = 1;
+  }
+  if (fd >= 0) {
+    (void)close(fd);
+  }
+  sync_ns += hist_now() - sync_start;
+}
+
+/*
+ * static void sync_outputs
+ *
+ * DESCRIPTION:
+ *
+ * Push what we have written to the output files towards the disk so
+ * the dirty pages don't pile up and the final --fsync is quick.
+ * Where we can we wait for the write-back that we started last time,
+ * which has had the whole interval to finish, and then start it on
+ * the new pages without waiting for them.  Otherwise we fdatasync.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fds -> Output file descriptors that we are syncing.  Entries of -1
+ * are skipped.
+ *
+ * fd_n -> Number of output file descriptors.
+ */
+static	void	sync_outputs(const int *fds, const int fd_n)
+{
+  int	fd_c;
+  
+  unsigned long long sync_start = hist_now();
+  for (fd_c = 0; fd_c < fd_n; fd_c++) {
+    int fd = fds[fd_c];
+    if (fd < 0) {
+      continue;
+    }
+#if HAVE_SYNC_FILE_RANGE && defined(SYNC_FILE_RANGE_WRITE)
+    int ret = sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE);
+    if (ret == 0) {
+      ret = sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+    /* pipes and devices don't support it which is fine */
+    if (ret != 0 && errno == ESPIPE) {
+      ret = 0;
+    }
+#elif HAVE_FDATASYNC
+    int ret = fdatasync(fd);
+#else
+    int ret = fsync(fd);
+#endif
+    if (ret != 0 && errno != EINVAL) {
+      (void)fprintf(stderr, "%s: could not sync output file: %s\n",
+		    argv_program, strerror(errno));
+      METRICS_ADD(metrics_p, me_errors, 1);
+    }
+  }
+  sync_ns += hist_now() - sync_start;
+}
+
+/*
+ * Build the path of the pre-opened next segment of an output file
+ * which is a hidden file in the same directory.
+ */
+static	void	next_seg_path(const char *path, char *buf, const int path_size)
+{
+  const char	*base = strrchr(path, '/');
+  
+  base = (base == NULL ? path : base + 1);
+  loc_snprintf(buf, path_size, ROTATE_NEXT_FORMAT, (int)(base - path), path,
+	       base);
+}
+
+/*
+ * Find the number after the highest numbered path.N segment that is
+ * already in the directory, even if it has been compressed since.
+ */
+static	int	first_seg_number(const char *path)
+{
+  const char	*base = strrchr(path, '/');
+  char		dir_path[1024];
+  int		max = 0;
+  
+  if (base == NULL) {
+    strcpy(dir_path, ".");
+    base = path;
+  }
+  else {
+    loc_snprintf(dir_path, sizeof(dir_path), "%.*s",
+		 (int)(base - path == 0 ? 1 : base - path), path);
+    base++;
+  }
+  int base_len = strlen(base);
+  
+  DIR *dir = opendir(dir_path);
+  if (dir == NULL) {
+    return 1;
+  }
+  struct dirent *entry_p;
+  while ((entry_p = readdir(dir)) != NULL) {
+    const char *name = entry_p->d_name;
+    if (strncmp(name, base, base_len) == 0 && name[base_len] == '.'
+	&& name[base_len + 1] >= '0' && name[base_len + 1] <= '9') {
+      int num = atoi(name + base_len + 1);
+      if (num > max) {
+	max = num;
+      }
+    }
+  }
+  (void)closedir(dir);
+  return max + 1;
+}
+
+/*
+ * Open the next segment of an output file ahead of time.
+ */
+static	int	open_next_seg(const char *path)
+{
+  char	next_path[1024];
+  
+  next_seg_path(path, next_path, sizeof(next_path));
+  return open_output(next_path, OUTPUT_TRUNC);
+}
+
+/*
+ * Reap the compressors that have finished or wait for all of them.
+ */
+static	void	reap_compress(const int wait_b)
+{
+  int	pid_c;
+  
+  for (pid_c = 0; pid_c < compress_n;) {
+    if (waitpid(compress_pids[pid_c], NULL, (wait_b ? 0 : WNOHANG)) == 0) {
+      pid_c++;
+      continue;
+    }
+    compress_pids[pid_c] = compress_pids[--compress_n];
+  }
+}
+
+/*
+ * static void compress_seg
+ *
+ * DESCRIPTION:
+ *
+ * Run the --rotate-compress program on a closed segment in the
+ * background.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the segment.
+ */
+static	void	compress_seg(const char *path)
+{
+  reap_compress(0);
+  
+  pid_t *pids = (pid_t *)realloc(compress_pids,
+				 (compress_n + 1) * sizeof(pid_t));
+  if (pids == NULL) {
+    return;
+  }
+  compress_pids = pids;
+  
+  (void)fflush(stdout);
+  (void)fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    (void)fprintf(stderr, "%s: could not fork %s: %s\n",
+		  argv_program, rotate_compress, strerror(errno));
+    METRICS_ADD(metrics_p, me_errors, 1);
+    return;
+  }
+  if (pid == 0) {
+    /* don't hold onto our stdin or stdout */
+    int null_fd = open("/dev/null", O_RDWR, 0);
+    if (null_fd >= 0) {
+      (void)dup2(null_fd, STDIN_FD);
+      (void)dup2(null_fd, STDOUT_FILENO);
+    }
+    (void)execlp(rotate_compress, rotate_compress, path, (char *)NULL);
+    (void)fprintf(stderr, "%s: could not run %s: %s\n",
+		  argv_program, rotate_compress, strerror(errno));
+    _exit(1);
+  }
+  compress_pids[compress_n++] = pid;
+}
+
+/*
+ * static void rotate_outputs
+ *
+ * DESCRIPTION:
+ *
+ * Close the current segment of each output file under its rotated
+ * name and switch to the segment that we opened ahead of time.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fds <-> Output file descriptors which are switched to the new
+ * segments.
+ */
+static	void	rotate_outputs(int *fds)
+{
+  char		old_path[1024], next_path[1024], stamp[64];
+  int		file_c;
+  
+  time_t now = time(NULL);
+  if (rotate_stamp_b) {
+    (void)strftime(stamp, sizeof(stamp), ROTATE_STAMP_FORMAT,
+		   localtime(&now));
+  }
+  
+  for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+    char *path = ARGV_ARRAY_ENTRY(outfiles, char *, file_c);
+    int old_fd = fds[file_c];
+    if (old_fd < 0) {
+      continue;
+    }
+    
+    /* name the old segment and make sure we don't reuse a name */
+    if (rotate_stamp_b) {
+      loc_snprintf(old_path, sizeof(old_path), "%s.%s", path, stamp);
+      int dup_c;
+      for (dup_c = 1; access(old_path, F_OK) == 0; dup_c++) {
+	loc_snprintf(old_path, sizeof(old_path), "%s.%s.%d", path, stamp,
+		     dup_c);
+      }
+    }
+    else {
+      loc_snprintf(old_path, sizeof(old_path), "%s.%d", path,
+		   seg_numbers[file_c]++);
+    }
+    if (rename(path, old_path) != 0) {
+      output_error(fds, file_c, "rename", errno);
+      continue;
+    }
+    
+    /* switch to the segment we opened ahead or open it now */
+    next_seg_path(path, next_path, sizeof(next_path));
+    if (next_fds[file_c] >= 0 && rename(next_path, path) == 0) {
+      fds[file_c] = next_fds[file_c];
+    }
+    else {
+      if (next_fds[file_c] >= 0) {
+	(void)close(next_fds[file_c]);
+	(void)unlink(next_path);
+	next_fds[file_c] = -1;
+      }
+      fds[file_c] = open_output(path, OUTPUT_TRUNC);
+      if (fds[file_c] < 0) {
+	/* save it since closing the old segment can change it */
+	int error = errno;
+	close_output(old_fd);
+	output_error(fds, file_c, "open", error);
+	continue;
+      }
+    }
+    close_output(old_fd);
+    sync_parent(path);
+    
+    if (rotate_compress != NULL) {
+      compress_seg(old_path);
+    }
+    next_fds[file_c] = open_next_seg(path);
+  }
+  
+  seg_start = now;
+}
+
+/*
+ * Return the millisecs until the -f segments are due to be rotated by
+ * --rotate-secs, 0 if they are due now, or -1 if there is no time
+ * rotation.
+ */
+static	int	rotate_msecs(void)
+{
+  time_t	now;
+  
+  if (rotate_secs <= 0 || next_fds == NULL) {
+    return -1;
+  }
+  now = time(NULL);
+  if (now - seg_start >= rotate_secs) {
+    return 0;
+  }
+  return (seg_start + rotate_secs - now) * 1000;
+}
+
+/*
+ * static void report_rate
+ *
+ * DESCRIPTION:
+ *
+ * Print the -R rate info if it is time for the next report.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * next_rate_p <-> When the next report is due which is moved along if
+ * we report.
+ *
+ * rate_every_p -> How often we report.
+ *
+ * write_bytes_c -> Number of bytes that we have written.
+ *
+ * last_write_c_p <-> Number of bytes written at the last report.
+ */
+static	void	report_rate(struct timeval *next_rate_p,
+			    struct timeval *rate_every_p,
+			    const unsigned long long write_bytes_c,
+			    unsigned long long *last_write_c_p)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (check_timeval_after(&now, next_rate_p)) {
+    /* the time since the last report is the period plus how late we are */
+    float sec_diff = (float)rate_every_p->tv_sec + (float)rate_every_p->tv_usec / 1000000.0 + (float)(now.tv_sec - next_rate_p->tv_sec) + (float)(now.tv_usec - next_rate_p->tv_usec) / 1000000.0;
+    unsigned long long diff = (float)(write_bytes_c - *last_write_c_p) / sec_diff;
+    char buf2[BYTE_SIZE_BUF_LEN];
+    (void)fprintf(stderr, "\rWriting at %s per sec (total %s)",
+		  byte_size(diff, NULL, 0), byte_size(write_bytes_c, buf2, sizeof(buf2)));
+    if (ring_p != NULL) {
+      (void)fprintf(stderr, " ring %d%% full", ring_fill_pct(ring_p));
+    }
+    (void)fprintf(stderr, "      ");
+    *next_rate_p = now;
+    timeval_add(rate_every_p, next_rate_p);
+    *last_write_c_p = write_bytes_c;
+  }
+}
+
+/*
+ * Poll the input for up to a number of milliseconds or forever if -1.
+ * Returns the poll or select result.
+ */
+static	int	poll_input(const int fd, const int timeout_msecs)
+{
+  int	ret;
+  
+#if HAVE_POLL
+  struct pollfd	pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  ret = poll(&pfd, 1, timeout_msecs);
+#else
+  fd_set		listen_set;
+  struct timeval	timeout, *timeout_p = NULL;
+  FD_ZERO(&listen_set);
+  FD_SET(fd, &listen_set);
+  if (timeout_msecs >= 0) {
+    timeout.tv_sec = timeout_msecs / 1000;
+    timeout.tv_usec = (timeout_msecs % 1000) * 1000;
+    timeout_p = &timeout;
+  }
+  ret = select(fd + 1, &listen_set, NULL, NULL, timeout_p);
+#endif
+  if (ret < 0 && errno != EINTR) {
+    (void)fprintf(stderr, "%s: could not wait on %s: %s\n",
+		  argv_program, input_name(input_c), strerror(errno));
+    exit(1);
+  }
+  return ret;
+}
+
+/*
+ * static void wait_input
+ *
+ * DESCRIPTION:
+ *
+ * Wait for a non-blocking input to have something for us to read.
+ * We return early if a signal arrives, it is time for the next -R
+ * report, or the -f segments are due to be rotated.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> Input file descriptor that we are waiting on.
+ *
+ * next_rate_p -> When the next -R report is due or NULL if none.
+ */
+static	void	wait_input(const int fd, struct timeval *next_rate_p)
+{
+  int	timeout_msecs = -1;
+  
+  if (next_rate_p != NULL) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    timeout_msecs = 0;
+    if (check_timeval_after(next_rate_p, &now)) {
+      timeout_msecs = (next_rate_p->tv_sec - now.tv_sec) * 1000
+	+ (next_rate_p->tv_usec - now.tv_usec) / 1000 + 1;
+    }
+  }
+  int rotate_timeout = rotate_msecs();
+  if (rotate_timeout >= 0
+      && (timeout_msecs < 0 || rotate_timeout < timeout_msecs)) {
+    timeout_msecs = rotate_timeout;
+  }
+  
+  (void)poll_input(fd, timeout_msecs);
+}
+
+/*
+ * static int coalesce_more
+ *
+ * DESCRIPTION:
+ *
+ * Decide whether to read more small records into the buffer before
+ * passing it on.  We wait for the input until the --coalesce-msecs
+ * since the first read of the batch are up.
+ *
+ * RETURNS:
+ *
+ * 1 if the input has more for us and we should read again else 0 to
+ * write out what we have.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> Input file descriptor that we are reading.
+ *
+ * start -> hist_now time of the first read of the batch.
+ */
+static	int	coalesce_more(const int fd, const unsigned long long start)
+{
+  unsigned long long	waited = hist_now() - start;
+  unsigned long long	limit = (unsigned long long)coalesce_msecs * 1000000ULL;
+  
+  if (waited >= limit) {
+    return 0;
+  }
+  /* round up so we don't spin on a sub-millisecond remainder */
+  return (poll_input(fd, (limit - waited + 999999ULL) / 1000000ULL) > 0);
+}
+
+/*
+ * static int transfer
+ *
+ * DESCRIPTION:
+ *
+ * Move the data from the input through to the outputs according to
+ * our arguments and report on it.
+ *
+ * RETURNS:
+ *
+ * Exit status of 0 if all went well or 1 if an output was dropped or
+ * failed to sync or the input did not verify.
+ *
+ * ARGUMENTS:
+ *
+ * first_fd -> File descriptor of the first input or SYNTH_FD to
+ * read the synthetic input.  We move on to the rest of the inputs
+ * when we reach its EOF.
+ */
+static	int	transfer(const int first_fd)
+{
+  int			input_fd = first_fd;
+  unsigned long long	write_bytes_c = 0, last_write_c = 0;
+  unsigned long long	out_offset = 0, sparse_skip_c = 0;
+  unsigned long		read_c = 0;
+  unsigned long		to_write, min_write = 0;
+  unsigned long		write_size, write_c = 0;
+  int			eof_b = 0, open_out_b = 1, replay_b = 0;
+  unsigned long long	sync_c = 0, last_sync = hist_now();
+  unsigned long long	spin_start = 0, read_done = 0, batch_start = 0;
+  int			*out_fds = NULL;
+  struct timeval	next_rate, rate_every;
+
+  
+  if (rate_every_secs > 0.0) {
+    rate_every.tv_sec = (int)rate_every_secs;
+    rate_every.tv_usec = ((float)rate_every_secs - (float)rate_every.tv_sec) * 1000000.0;
+    gettimeofday(&next_rate, NULL);
+    timeval_add(&rate_every, &next_rate);
+  }
+
+  int input_sparse_b = start_input(input_fd);
+  
+  /*
+   * Time from the first read of a batch until the write that passes it
+   * on.  This costs a couple of clock reads per read so it is only done
+   * when someone is looking at the latency.
+   */
+  int forward_b = ((busy_poll_usecs > 0 || histograms_b)
+		   && (pass_b || outfiles.aa_entry_n > 0));
+  
+  /* the bench cases don't go through main's parsing */
+  if (outputs == NULL) {
+    parse_outputs();
+  }
+  
+  /* the output paths are opened when we first write to them */
+  int file_c;
+  if (outfiles.aa_entry_n > 0) {
+    out_fds = (int *)malloc(outfiles.aa_entry_n * sizeof(int));
+    if (out_fds == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+      out_fds[file_c] = -1;
+    }
+  }
+  
+  if (histograms_b) {
+    if (outfiles.aa_entry_n > 0) {
+      file_hists = (hist_t *)calloc(outfiles.aa_entry_n, sizeof(hist_t));
+      if (file_hists == NULL) {
+	perror("malloc");
+	exit(1);
+      }
+    }
+    dump_signal_init(SIGUSR1);
+  }
+  
+  /* rotation needs the next segments and their numbers */
+  if ((rotate_size > 0 || rotate_secs > 0) && outfiles.aa_entry_n > 0) {
+    next_fds = (int *)malloc(outfiles.aa_entry_n * sizeof(int));
+    seg_numbers = (int *)calloc(outfiles.aa_entry_n, sizeof(int));
+    if (next_fds == NULL || seg_numbers == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+      next_fds[file_c] = -1;
     }
+    seg_start = time(NULL);
   }
   
-  char *buf = (char *)malloc(buf_size);
+  char *buf = (char *)iobuf_alloc(buf_size);
   if (buf == NULL) {
     (void)fprintf(stderr, "could not allocate %ld bytes for buffer\n",
 		  buf_size);
     exit(1);
   }
   
+  /* with read-all we hold the input in a store until we reach the EOF */
+  store_t all_store;
+  if (read_all_b) {
+    unsigned long seg_size = STORE_SEGMENT_SIZE;
+    if (seg_size < buf_size) {
+      seg_size = buf_size;
+    }
+    store_init(&all_store, seg_size, all_read_mem, spill_dir);
+  }
+  
   md5_t md5;
   if (run_md5_b) {
     md5_init(&md5);
   }
   
+  verify_t verify;
+  int verify_b = 0, verify_stop_b = 0;
+  if (verify_gen_p != NULL) {
+    if (verify_init(&verify, verify_gen_p, buf_size) != 0) {
+      (void)fprintf(stderr, "%s: could not allocate %ld bytes for --verify\n",
+		    argv_program, buf_size);
+      exit(1);
+    }
+    verify_b = 1;
+  }
+  else if (compare_path != NULL) {
+    if (verify_open(&verify, compare_path, buf_size) != 0) {
+      (void)fprintf(stderr, "%s: could not open --compare file %s: %s\n",
+		    argv_program, compare_path, strerror(errno));
+      exit(1);
+    }
+    verify_b = 1;
+  }
+  
+  dedup_t dedup;
+  if (dedup_dir != NULL) {
+    dedup_b = 1;
+  }
+  if (dedup_b && dedup_init(&dedup, dedup_dir) != 0) {
+    (void)fprintf(stderr, "%s: could not setup dedup store %s: %s\n",
+		  argv_program, (dedup_dir == NULL ? "" : dedup_dir),
+		  strerror(errno));
+    exit(1);
+  }
+  
   struct timeval start;
   gettimeofday(&start, NULL);
   
   if (write_page_b) {
-    (void)fputs(PAGINATION_ESC, stdout);
-    (void)fputc(PAGINATION_START, stdout);
-    if (very_verbose_b) {
-      (void)fprintf(stderr, "wrote starting pagination\n");
-    }
+    write_page_esc(PAGINATION_START);
+    trace_record(TRACE_PAGE_START, 0);
   }
   
   if (throttle_size > 0) {
     /* if we sleep for 1/X of a second so write 1/X of throttle-size */
     min_write = throttle_size / WRITES_PER_SEC;
+    if (out_block_size > 0 && min_write % out_block_size != 0) {
+      min_write += out_block_size - min_write % out_block_size;
+    }
   }
   
   /* read in stuff and count the number */
   unsigned long buf_len = 0;
-  fd_set listen_set;
   while (1) {
     
+    if (hist_signal_b) {
+      hist_signal_b = 0;
+      print_histograms();
+    }
+    if (trace_signal_b) {
+      trace_signal_b = 0;
+      if (trace_dump() != 0) {
+	(void)fprintf(stderr, "%s: could not write trace file %s: %s\n",
+		      argv_program, trace_path, strerror(errno));
+      }
+    }
+    
     if (eof_b) {
       to_write = buf_len;
     }
     else {
-      if (non_block_b) {
-	FD_ZERO(&listen_set);
-	FD_SET(input_fd, &listen_set);
-	int ret = select(1, &listen_set, NULL, NULL, NULL);
-	if (ret == -1) {
-	  (void)fprintf(stderr, "%s: select error: %s\n",
-			argv_program, strerror(errno));
-	  exit(1);
-	}
-	if (! FD_ISSET(input_fd, &listen_set)) {
-	  continue;
-	}
-      }
-      
       /* read in data from input stream */
       if (buf_size <= buf_len) {
 	/* we've already processed the buffer so we don't need to paginate */
@@ -532,24 +2580,102 @@ int	main(int argc, char **argv)
       }
       else {
 	unsigned long read_size = buf_size - buf_len;
-	if (stop_after > 0 && stop_after - read_c < read_size) {
+	if ((! replay_b) && stop_after > 0 && stop_after - read_c < read_size) {
 	  read_size = stop_after - read_c;
 	}
 	
-	/* read from standard-in */
-	int read_n = read(input_fd, buf + buf_len, read_size);
-	if (read_n < 0) {
-	  (void)fprintf(stderr, "%s: read on stdin error: %s\n",
-			argv_program, strerror(errno));
+	/*
+	 * The input may be idle for a long time so we can't sit in a
+	 * read past when the -f segments are due to be rotated.
+	 */
+	if (rotate_msecs() == 0 && (! replay_b)) {
+	  if (out_offset > 0) {
+	    rotate_outputs(out_fds);
+	    out_offset = 0;
+	  }
+	  else {
+	    /* no point in closing an empty segment */
+	    seg_start = time(NULL);
+	  }
+	}
+	if (rotate_msecs() > 0 && (! replay_b) && input_fd >= 0
+	    && ring_p == NULL && poll_input(input_fd, rotate_msecs()) <= 0) {
+	  continue;
+	}
+	
+	int read_n;
+	unsigned long long read_start = stage_start();
+	if (replay_b) {
+	  /* read back the input that we stored with read-all */
+	  read_n = store_read(&all_store, buf + buf_len, read_size);
+	}
+	else if (input_fd == SYNTH_FD) {
+	  read_n = read_synth(buf + buf_len, read_size);
+	}
+	else if (input_fd == STRIPE_FD) {
+	  read_n = stripe_read(stripe_in_p, buf + buf_len, read_size);
+	}
+	else if (fec_in_p != NULL) {
+	  read_n = fec_read(fec_in_p, input_fd, buf + buf_len, read_size);
+	}
+	else if (input_sparse_b) {
+	  read_n = read_sparse(input_fd, buf + buf_len, read_size);
+	}
+	else if (ring_p != NULL) {
+	  read_n = ring_read(ring_p, input_fd, buf + buf_len, read_size);
+	}
+	else {
+	  /* read from standard-in */
+	  read_n = read(input_fd, buf + buf_len, read_size);
+	}
+	stage_end(&stage_hists[STAGE_READ], read_start);
+	if (read_n < 0 && errno == EINTR) {
+	  /* a signal interrupted us so go around and see what it wanted */
+	  continue;
+	}
+	else if (read_n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+		 && (! replay_b)) {
+	  if (busy_poll_usecs > 0) {
+	    /* spin for a bit since the next message is usually close */
+	    unsigned long long spin_now = hist_now();
+	    if (spin_start == 0) {
+	      spin_start = spin_now;
+	    }
+	    if (spin_now - spin_start < busy_poll_usecs * 1000ULL) {
+	      continue;
+	    }
+	  }
+	  /* a non-blocking input has nothing for us so do other work */
+	  wait_input(input_fd, (rate_every_secs > 0.0 ? &next_rate : NULL));
+	  if (rate_every_secs > 0.0) {
+	    report_rate(&next_rate, &rate_every, write_bytes_c,
+			&last_write_c);
+	  }
+	  continue;
+	}
+	else if (read_n < 0) {
+	  (void)fprintf(stderr, "%s: read on %s error: %s\n",
+			argv_program,
+			(replay_b ? "spill file" : input_name(input_c)),
+			strerror(errno));
 	  exit(1);
 	}
+	else if (read_n > 0 && replay_b) {
+	  trace_record(TRACE_REPLAY, read_n);
+	  buf_len += read_n;
+	  to_write = buf_len;
+	}
 	else if (read_n > 0) {
-	  if (very_verbose_b) {
-	    (void)fprintf(stderr, "read %d bytes\n", read_n);
+	  trace_record(TRACE_READ, read_n);
+	  spin_start = 0;
+	  if (forward_b && read_done == 0) {
+	    read_done = hist_now();
 	  }
 	  
 	  read_c += read_n;
 	  buf_len += read_n;
+	  METRICS_ADD(metrics_p, me_bytes_in, read_n);
+	  METRICS_ADD(metrics_p, me_reads, 1);
 	  
 	  /* are we stopping after X bytes */
 	  if (stop_after > 0 && read_c >= stop_after) {
@@ -557,37 +2683,68 @@ int	main(int argc, char **argv)
 	    eof_b = 1;
 	  }
 	  
+	  /*
+	   * Gather up small reads so the hashing and writes are done on
+	   * bigger blocks but only for so long.
+	   */
+	  if (coalesce_size > 0 && input_fd != SYNTH_FD && ring_p == NULL
+	      && fec_in_p == NULL
+	      && (! eof_b)
+	      && buf_len < coalesce_size && buf_len < buf_size) {
+	    if (batch_start == 0) {
+	      batch_start = hist_now();
+	    }
+	    if (coalesce_more(input_fd, batch_start)) {
+	      continue;
+	    }
+	  }
+	  batch_start = 0;
+	  
 	  if (read_page_b) {
+	    unsigned long long page_start = stage_start();
 	    buf_len = read_pagination(buf, buf_len, &to_write, 0);
+	    stage_end(&stage_hists[STAGE_READ_PAGE], page_start);
 	  }
 	  else {
 	    to_write = buf_len;
 	  }
 	  
+	  /* hold back a partial block until we have the rest of it */
+	  if (out_block_size > 0 && (! eof_b)) {
+	    to_write -= to_write % out_block_size;
+	  }
+	  
 	  /*
-	   * if we are reading all of the input before we output then
-	   * we'll have to grow the input buffer
+	   * If we are reading all of the input before we output then
+	   * we save it in the store and write it when we reach the EOF.
 	   */
 	  if (read_all_b) {
-	    if (buf_len == buf_size) {
-	      /* grow our input buffer */
-	      buf = realloc(buf, buf_size + buf_len);
-	      if (buf == NULL) {
-		(void)fprintf(stderr,
-			      "could not reallocate %ld bytes for buffer\n",
-			      buf_size + buf_len);
-		exit(1);
-	      }
-	      buf_size += buf_len;
-	    }
-	    /* we'll write when we reach the EOF */
+	    store_all(&all_store, buf, &buf_len, to_write);
 	    to_write = 0;
+	    if (eof_b) {
+	      /* stop-after was reached so start writing */
+	      eof_b = 0;
+	      replay_b = 1;
+	    }
 	  }
 	}
 	else {
 	  /* EOF on read */
 	  
-	  if (read_page_b) {
+	  /* move on to the next input as if they were concatenated */
+	  if ((! replay_b) && input_fd != SYNTH_FD && input_fd != STRIPE_FD
+	      && input_c + 1 < inputs.aa_entry_n) {
+	    finish_input();
+	    if (input_fd != STDIN_FD) {
+	      (void)close(input_fd);
+	    }
+	    input_fd = open_input(input_c + 1);
+	    input_c++;
+	    input_sparse_b = start_input(input_fd);
+	    continue;
+	  }
+	  
+	  if (read_page_b && (! replay_b)) {
 	    /* we do this here so it can error because of no end tag */
 	    buf_len = read_pagination(buf, buf_len, &to_write, 1);
 	  }
@@ -595,6 +2752,14 @@ int	main(int argc, char **argv)
 	    to_write = buf_len;
 	  }
 	  
+	  if (read_all_b && (! replay_b)) {
+	    /* we have read everything so now write it out from the store */
+	    store_all(&all_store, buf, &buf_len, to_write);
+	    to_write = 0;
+	    replay_b = 1;
+	    continue;
+	  }
+	  
 	  /* is the buffer now empty? */
 	  if (buf_len == 0) {
 	    break;
@@ -650,7 +2815,10 @@ int	main(int argc, char **argv)
 	struct timeval timeout;
 	timeout.tv_sec = 0;
 	timeout.tv_usec = 1000000 / WRITES_PER_SEC;
+	unsigned long long sleep_start = hist_now();
 	(void)select(0, NULL, NULL, NULL, &timeout);
+	METRICS_ADD(metrics_p, me_throttle_ns, hist_now() - sleep_start);
+	stage_end(&stage_hists[STAGE_THROTTLE], sleep_start);
 	
 	/* write our minimal chunk */
 	write_size = min_write;
@@ -660,12 +2828,27 @@ int	main(int argc, char **argv)
       if (write_size > to_write) {
 	write_size = to_write;
       }
+      
+      /* only whole blocks and the rest waits for the next write */
+      if (out_block_size > 0 && write_size < to_write) {
+	write_size -= write_size % out_block_size;
+      }
+    }
+    
+    /* don't write past the end of the current -f segment */
+    if (rotate_size > 0 && outfiles.aa_entry_n > 0
+	&& write_size > rotate_size - out_offset) {
+      write_size = rotate_size - out_offset;
     }
     
     /* should we write it? */
     if (write_size > 0) {
       
+      /* the final flush is the only write that --pad-block fills out */
+      last_block_b = (eof_b && write_size == buf_len);
+      
       if (pass_b) {
+	unsigned long long write_start = stage_start();
 	if (write_page_b) {
 	  if (eof_b && write_size == buf_len) {
 	    write_size = write_pagination(buf, write_size, 1);
@@ -673,59 +2856,115 @@ int	main(int argc, char **argv)
 	  else {
 	    write_size = write_pagination(buf, write_size, 0);
 	  }
+	  stage_end(&stage_hists[STAGE_WRITE_PAGE], write_start);
 	}
 	else {
-	  if (fwrite(buf, sizeof(char), write_size, stdout) != write_size) {
+	  if (write_blocks(STDOUT_FILENO, buf, write_size) != (long)write_size) {
 	    (void)fprintf(stderr,
-			  "%s: ERROR.  Could not pass block to stdout.\n",
-			  argv_program);
+			  "%s: ERROR.  Could not pass block to stdout: %s\n",
+			  argv_program, strerror(errno));
 	    exit(1);
 	  }
+	  stage_end(&stage_hists[STAGE_STDOUT], write_start);
 	}
-	if (flush_out_b) {
-	  (void)fflush(stdout);
-	}
+	METRICS_ADD(metrics_p, me_stdout_bytes, write_size);
       }
       
       if (run_md5_b) {
+	unsigned long long md5_start = stage_start();
 	md5_process(&md5, buf, write_size);
+	stage_end(&stage_hists[STAGE_MD5], md5_start);
+      }
+      if (verify_b) {
+	verify_process(&verify, buf, write_size);
+	if (compare_stop_b && verify.ve_range_n + verify.ve_in_range_b > 0) {
+	  /* write out this buffer and then stop */
+	  verify_stop_b = 1;
+	}
+      }
+      if (dedup_b && dedup_process(&dedup, buf, write_size) != 0) {
+	(void)fprintf(stderr, "%s: ERROR.  Could not write to dedup store: %s\n",
+		      argv_program, strerror(errno));
+	exit(1);
       }
       
       /* write out to any files */
-      int file_c;
       for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
 	if (open_out_b) {
 	  char	*path = ARGV_ARRAY_ENTRY(outfiles, char *, file_c);
 	  
-	  streams[file_c] = fopen(path, "w");
-	  if (streams[file_c] == NULL) {
-	    (void)fprintf(stderr, "%s: cannot fopen(%s): %s\n", 
-			  argv_program, path, strerror(errno));
+	  out_fds[file_c] = open_output(path, outputs[file_c].ou_mode);
+	  if (out_fds[file_c] < 0) {
+	    output_error(out_fds, file_c, "open", errno);
+	  }
+	  else {
+	    sync_parent(path);
+	    if (next_fds != NULL) {
+	      seg_numbers[file_c] = first_seg_number(path);
+	      next_fds[file_c] = open_next_seg(path);
+	    }
 	  }
 	}
 	
-	if (streams[file_c] != NULL) {
-	  if (fwrite(buf, sizeof(char), write_size,
-		     streams[file_c]) != write_size) {
-	    (void)fprintf(stderr,
-			  "%s: ERROR.  Could not write block to file.\n",
-			  argv_program);
-	    exit(1);
-	  }
-	  if (flush_out_b) {
-	    (void)fflush(streams[file_c]);
+	if (striping_b) {
+	  continue;
+	}
+	if (out_fds[file_c] >= 0 && (! sparse_b)) {
+	  unsigned long long file_start = stage_start();
+	  (void)write_output(out_fds, file_c, buf, write_size);
+	  if (file_hists != NULL) {
+	    stage_end(&file_hists[file_c], file_start);
 	  }
 	}
+	if (out_fds[file_c] >= 0) {
+	  METRICS_ADD(metrics_p, me_file_bytes[file_c], write_size);
+	  outputs[file_c].ou_bytes += write_size;
+	}
       }
       open_out_b = 0;
+      if (striping_b) {
+	write_stripes(out_fds, buf, write_size);
+      }
+      if (sparse_b) {
+	unsigned long long sparse_start = stage_start();
+	sparse_skip_c += write_sparse(out_fds, outfiles.aa_entry_n, buf,
+				      write_size, out_offset);
+	stage_end(&stage_hists[STAGE_SPARSE], sparse_start);
+      }
+      out_offset += write_size;
+      
+      /* time from the read returning to the bytes being passed on */
+      if (read_done > 0) {
+	hist_record(&forward_hist, hist_now() - read_done);
+	read_done = 0;
+      }
+      
+      /* write back the -f files every so many bytes or millisecs */
+      if (sync_size > 0 || sync_msecs > 0) {
+	sync_c += write_size;
+	if ((sync_size > 0 && sync_c >= sync_size)
+	    || (sync_msecs > 0
+		&& hist_now() - last_sync >= sync_msecs * 1000000ULL)) {
+	  sync_outputs(out_fds, outfiles.aa_entry_n);
+	  sync_c = 0;
+	  last_sync = hist_now();
+	}
+      }
       
-      if (very_verbose_b) {
-	(void)fprintf(stderr, "wrote %ld bytes\n", write_size);
+      /* start new segments of the -f files if it is time */
+      if (next_fds != NULL
+	  && ((rotate_size > 0 && out_offset >= rotate_size)
+	      || rotate_msecs() == 0)) {
+	rotate_outputs(out_fds);
+	out_offset = 0;
       }
       
+      trace_record(TRACE_WRITE, write_size);
+      
       /* count the bytes */
       write_bytes_c += write_size;
       write_c++;
+      METRICS_ADD(metrics_p, me_writes, 1);
       
       /*
        * Print out our dots.  Because write_bytes_c might overflow and
@@ -744,100 +2983,735 @@ int	main(int argc, char **argv)
 	memmove(buf, buf + write_size, buf_len - write_size);
       }
       buf_len -= write_size;
-      if (eof_b && buf_len == 0) {
+      if ((eof_b && buf_len == 0) || verify_stop_b) {
 	break;
       }
     }
-    
-    if (rate_every_secs > 0.0) {
-      struct timeval now;
-      gettimeofday(&now, NULL);
-      if (check_timeval_after(&now, &next_rate)) {
-	float sec_diff = (float)(now.tv_sec - next_rate.tv_sec) + (float)(now.tv_usec - next_rate.tv_usec) / 1000000.0;
-	unsigned long long diff = (float)(write_bytes_c - last_write_c) / sec_diff;
-	char buf2[BYTE_SIZE_BUF_LEN];
-	(void)fprintf(stderr, "\rWriting at %s per sec (total %s)      ",
-		      byte_size(diff, NULL, 0), byte_size(write_bytes_c, buf2, sizeof(buf2)));
-	next_rate = now;
-	timeval_add(&rate_every, &next_rate);
-	last_write_c = write_bytes_c;
-      }
+    
+    if (rate_every_secs > 0.0) {
+      report_rate(&next_rate, &rate_every, write_bytes_c, &last_write_c);
+    }
+  }
+  
+  if (rate_every_secs > 0.0) {
+    (void)fputc('\n', stderr);
+  }
+  
+  if (write_page_b) {
+    write_page_esc(PAGINATION_END);
+    trace_record(TRACE_PAGE_END, 0);
+    flush_page_carry();
+    if (fec_out_p != NULL && fec_finish(fec_out_p, STDOUT_FILENO) != 0) {
+      (void)fprintf(stderr, "%s: ERROR.  Could not write fec block: %s\n",
+		    argv_program, strerror(errno));
+      exit(1);
+    }
+  }
+  
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  timeval_subtract(&start, &now);
+  
+  if (trace_dump() != 0) {
+    (void)fprintf(stderr, "%s: could not write trace file %s: %s\n",
+		  argv_program, trace_path, strerror(errno));
+  }
+  
+  if (dot_size > 0) {
+    (void)fputc('\n', stderr);
+  }
+  
+  /* write some report info */
+  if (verbose_b) {
+    long msecs = now.tv_usec / 1000;
+    (void)fprintf(stderr, "%s: processed %s in %ld.%03ld secs",
+		  argv_program, byte_size(read_c, NULL, 0), now.tv_sec, msecs);
+    /* NOTE: this needs to be in a separate printf */
+    float secs = ((float)now.tv_sec + ((float)now.tv_usec / 1000000.0));
+    unsigned long speed;
+    if (secs == 0.0) {
+      speed = read_c;
+    }
+    else {
+      speed = (float)read_c / secs;
+    }
+    (void)fprintf(stderr, " or %s per sec\n", byte_size(speed, NULL, 0));
+    if (sparse_b) {
+      (void)fprintf(stderr, "%s: skipped %s of zeros in output files\n",
+		    argv_program, byte_size(sparse_skip_c, NULL, 0));
+    }
+    if (read_all_b && all_store.st_spill_size > 0) {
+      (void)fprintf(stderr, "%s: spilled %s of input to disk\n",
+		    argv_program, byte_size(all_store.st_spill_size, NULL, 0));
+    }
+    if (fec_out_p != NULL && fec_out_p->fe_data_bytes > 0) {
+      (void)fprintf(stderr,
+		    "%s: fec wrote %llu groups of %d+%d blocks, %s of parity "
+		    "or %.1f%% overhead\n",
+		    argv_program, fec_out_p->fe_group_n, fec_out_p->fe_k,
+		    fec_out_p->fe_m, byte_size(fec_out_p->fe_parity_bytes, NULL, 0),
+		    (double)fec_out_p->fe_parity_bytes * 100.0
+		    / (double)fec_out_p->fe_data_bytes);
+    }
+    if (fec_in_p != NULL) {
+      (void)fprintf(stderr,
+		    "%s: fec rebuilt %llu data blocks in %llu of %llu "
+		    "groups\n",
+		    argv_program, fec_in_p->fe_repaired,
+		    fec_in_p->fe_repaired_groups, fec_in_p->fe_group_n);
+    }
+    if (busy_poll_usecs > 0 && (! histograms_b)) {
+      print_hist("forward", &forward_hist);
+    }
+  }
+  
+  if (striping_b) {
+    finish_stripes(out_fds);
+  }
+  
+  /* close the output paths */
+  for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+    if (out_fds[file_c] >= 0) {
+      close_output(out_fds[file_c]);
+    }
+    else if (outputs[file_c].ou_errno != 0) {
+      (void)fprintf(stderr, "%s: dropped %s after writing %s: %s\n",
+		    argv_program, ARGV_ARRAY_ENTRY(outfiles, char *, file_c),
+		    byte_size(outputs[file_c].ou_bytes, NULL, 0),
+		    strerror(outputs[file_c].ou_errno));
+    }
+  }
+  if (verbose_b && (fsync_b || sync_size > 0 || sync_msecs > 0)) {
+    char sync_buf[32];
+    (void)fprintf(stderr, "%s: spent %s syncing output files\n",
+		  argv_program, hist_duration(sync_ns, sync_buf,
+					      sizeof(sync_buf)));
+  }
+  
+  /* remove the next segments that we did not get to */
+  if (next_fds != NULL) {
+    for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
+      if (next_fds[file_c] >= 0) {
+	char next_path[1024];
+	next_seg_path(ARGV_ARRAY_ENTRY(outfiles, char *, file_c), next_path,
+		      sizeof(next_path));
+	(void)close(next_fds[file_c]);
+	(void)unlink(next_path);
+      }
+    }
+    free(next_fds);
+    next_fds = NULL;
+    free(seg_numbers);
+    seg_numbers = NULL;
+    reap_compress(1);
+  }
+  
+  /* close the input file if not stdin and any that we prefetched */
+  finish_input();
+  if (input_fd != STDIN_FD && input_fd != SYNTH_FD && input_fd != STRIPE_FD) {
+    (void)close(input_fd);
+  }
+  if (next_fd >= 0) {
+    (void)close(next_fd);
+    next_fd = -1;
+  }
+  
+  if (run_md5_b) {
+    char md5_result[MD5_SIZE];
+    md5_finish(&md5, md5_result);
+    char md5_string[64];
+    md5_sig_to_string(md5_result, md5_string, sizeof(md5_string));
+    
+    (void)fprintf(stderr, "%s: md5 signature of input = '%s'\n",
+		  argv_program, md5_string);
+  }
+  
+  int verify_failed_b = 0;
+  if (verify_b) {
+    if (verify_stop_b) {
+      /* we did not read the rest so the lengths cannot be compared */
+      verify.ve_ref_end_b = 1;
+    }
+    else if (verify_gen_p != NULL && stop_after > 0
+	     && verify.ve_offset < stop_after) {
+      (void)fprintf(stderr,
+		    "%s: verify FAILED: stream ended after %llu of %lu bytes\n",
+		    argv_program, verify.ve_offset, stop_after);
+      verify_failed_b = 1;
+    }
+    if (verify_finish(&verify, verbose_b) != 0) {
+      verify_failed_b = 1;
     }
   }
   
-  if (rate_every_secs > 0.0) {
-    (void)fputc('\n', stderr);
+  if (dedup_b) {
+    if (dedup_finish(&dedup) != 0) {
+      (void)fprintf(stderr, "%s: ERROR.  Could not write to dedup store: %s\n",
+		    argv_program, strerror(errno));
+      exit(1);
+    }
+  }
+  if (dedup_b && verbose_b) {
+    float ratio = 1.0;
+    if (dedup.dd_unique_byte_c > 0) {
+      ratio = (float)dedup.dd_byte_c / (float)dedup.dd_unique_byte_c;
+    }
+    char buf2[BYTE_SIZE_BUF_LEN];
+    (void)fprintf(stderr,
+		  "%s: dedup %llu chunks, %llu unique, %s of %s unique, "
+		  "ratio %.2f:1\n",
+		  argv_program, dedup.dd_chunk_c, dedup.dd_unique_c,
+		  byte_size(dedup.dd_unique_byte_c, NULL, 0),
+		  byte_size(dedup.dd_byte_c, buf2, sizeof(buf2)), ratio);
   }
   
-  if (write_page_b) {
-    (void)fputs(PAGINATION_ESC, stdout);
-    (void)fputc(PAGINATION_END, stdout);
-    if (very_verbose_b) {
-      (void)fprintf(stderr, "wrote ending pagination\n");
+  if (histograms_b) {
+    print_histograms();
+    if (file_hists != NULL) {
+      free(file_hists);
+      file_hists = NULL;
     }
   }
   
-  struct timeval now;
+  if (out_fds != NULL) {
+    free(out_fds);
+  }
+  if (read_all_b) {
+    store_clear(&all_store);
+  }
+  iobuf_free(buf, buf_size);
+  
+  /* our exit status needs to say if the outputs or input were bad */
+  if (output_failed_b || verify_failed_b) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * static int bench_case
+ *
+ * DESCRIPTION:
+ *
+ * Run one benchmark case by forking a child which transfers the
+ * synthetic input to /dev/null with the arguments that were set by
+ * the caller.  We then print a machine readable line with the
+ * results.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1
+ *
+ * ARGUMENTS:
+ *
+ * name -> Name of the case that we are running.
+ *
+ * file_n -> Number of /dev/null -f output files.
+ */
+static	int	bench_case(const char *name, const int file_n)
+{
+  struct rusage		usage_before, usage_after;
+  struct timeval	start, now;
+  int			status;
+  pid_t			pid;
+  
+  /* so the child doesn't duplicate any of our buffered output */
+  (void)fflush(stdout);
+  (void)getrusage(RUSAGE_CHILDREN, &usage_before);
+  gettimeofday(&start, NULL);
+  
+  pid = fork();
+  if (pid < 0) {
+    (void)fprintf(stderr, "%s: could not fork bench: %s\n",
+		  argv_program, strerror(errno));
+    return -1;
+  }
+  if (pid == 0) {
+    int	null_fd, file_c;
+    
+    null_fd = open("/dev/null", O_WRONLY, 0);
+    if (null_fd < 0) {
+      exit(1);
+    }
+    /* the parent reports on failures so drop the md5 and other output */
+    (void)dup2(null_fd, STDOUT_FILENO);
+    (void)dup2(null_fd, STDERR_FILENO);
+    (void)close(null_fd);
+    
+    if (file_n > 0) {
+      char **paths = (char **)malloc(file_n * sizeof(char *));
+      if (paths == NULL) {
+	exit(1);
+      }
+      for (file_c = 0; file_c < file_n; file_c++) {
+	paths[file_c] = "/dev/null";
+      }
+      outfiles.aa_entries = paths;
+    }
+    outfiles.aa_entry_n = file_n;
+    verbose_b = 0;
+    very_verbose_b = 0;
+    
+    exit(transfer(SYNTH_FD));
+  }
+  
+  if (waitpid(pid, &status, 0) != pid
+      || (! WIFEXITED(status)) || WEXITSTATUS(status) != 0) {
+    (void)fprintf(stderr, "%s: bench case %s failed\n", argv_program, name);
+    return -1;
+  }
   gettimeofday(&now, NULL);
+  (void)getrusage(RUSAGE_CHILDREN, &usage_after);
+  
   timeval_subtract(&start, &now);
+  timeval_subtract(&usage_before.ru_utime, &usage_after.ru_utime);
+  timeval_subtract(&usage_before.ru_stime, &usage_after.ru_stime);
+  timeval_add(&usage_after.ru_stime, &usage_after.ru_utime);
   
-  if (dot_size > 0) {
-    (void)fputc('\n', stderr);
+  double secs = (double)now.tv_sec + (double)now.tv_usec / 1000000.0;
+  double cpu_secs = (double)usage_after.ru_utime.tv_sec
+    + (double)usage_after.ru_utime.tv_usec / 1000000.0;
+  if (secs <= 0.0) {
+    secs = 0.000001;
   }
   
-  /* write some report info */
-  if (verbose_b) {
-    long msecs = now.tv_usec / 1000;
-    (void)fprintf(stderr, "%s: processed %s in %ld.%03ld secs",
-		  argv_program, byte_size(read_c, NULL, 0), now.tv_sec, msecs);
-    /* NOTE: this needs to be in a separate printf */
-    float secs = ((float)now.tv_sec + ((float)now.tv_usec / 1000000.0));
-    int speed;
-    if (secs == 0.0) {
-      speed = read_c;
+  (void)printf("case=%s buffer=%lu files=%d bytes=%llu secs=%.3f "
+	       "mb_per_sec=%.1f cpu_ns_per_byte=%.3f",
+	       name, buf_size, file_n, synth_size, secs,
+	       (double)synth_size / secs / (1024.0 * 1024.0),
+	       cpu_secs * 1000000000.0 / (double)synth_size);
+  if (throttle_size > 0) {
+    double rate = (double)synth_size / secs;
+    (void)printf(" target_per_sec=%lu achieved_per_sec=%.0f error_pct=%.2f",
+		 throttle_size, rate,
+		 (rate - (double)throttle_size) * 100.0 / (double)throttle_size);
+  }
+  (void)printf("\n");
+  return 0;
+}
+
+/*
+ * Run a bench case over bench_size bytes of the synthetic input that
+ * the caller set up.  Returns 0 on success or 1 on failure.
+ */
+static	int	bench_run(const char *name, const int file_n)
+{
+  synth_size = bench_size;
+  /* escape bodies are short so round them to not end mid-escape */
+  if (synth_body_len < BENCH_PATTERN_SIZE) {
+    synth_size -= bench_size % synth_body_len;
+  }
+  synth_pos = 0;
+  return (bench_case(name, file_n) == 0 ? 0 : 1);
+}
+
+/*
+ * static int run_bench
+ *
+ * DESCRIPTION:
+ *
+ * Run our benchmarks on synthetic input for the different buffer
+ * sizes to get repeatable numbers when comparing builds and flags.
+ * The case size can be set with -s and a single buffer size with -b.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - 1
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	int	run_bench(void)
+{
+  static unsigned long	buf_sizes[] = { 4096, 65536, 1024 * 1024, 0 };
+  static unsigned long	one_size[] = { 0, 0 };
+  static int		file_ns[] = { 1, 2, 4, 0 };
+  static char		esc_buf[32], esc_start_buf[32], esc_mid_buf[32];
+  static char		esc_end_buf[32];
+  unsigned long		*size_p, save_throttle = throttle_size;
+  unsigned int		seed = 1;
+  int			*file_n_p, ret = 0;
+  
+  if (stop_after > 0) {
+    bench_size = stop_after;
+    stop_after = 0;
+  }
+  if (argv_long_was_used(args, "buffer-size")) {
+    one_size[0] = buf_size;
+    size_p = one_size;
+  }
+  else {
+    size_p = buf_sizes;
+  }
+  
+  /* random data which won't have pagination escapes in it */
+  char *random_buf = (char *)malloc(BENCH_PATTERN_SIZE);
+  if (random_buf == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate bench data\n",
+		  argv_program);
+    return 1;
+  }
+  unsigned long rand_c;
+  for (rand_c = 0; rand_c < BENCH_PATTERN_SIZE; rand_c++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    random_buf[rand_c] = (char)(seed >> 11);
+  }
+  
+  /* escape-dense data which is all pagination escape sequences */
+  loc_snprintf(esc_buf, sizeof(esc_buf), "%s", PAGINATION_ESC);
+  loc_snprintf(esc_mid_buf, sizeof(esc_mid_buf), "%s%c", PAGINATION_ESC,
+	       PAGINATION_MID);
+  loc_snprintf(esc_end_buf, sizeof(esc_end_buf), "%s%c", PAGINATION_ESC,
+	       PAGINATION_END);
+  loc_snprintf(esc_start_buf, sizeof(esc_start_buf), "%s%c", PAGINATION_ESC,
+	       PAGINATION_START);
+  
+  throttle_size = 0;
+  (void)printf("# null %s bench\n", NULL_VERSION_STRING);
+  
+  for (; *size_p != 0 && ret == 0; size_p++) {
+    buf_size = *size_p;
+    
+    synth_head = "";
+    synth_tail = "";
+    synth_body = random_buf;
+    synth_body_len = BENCH_PATTERN_SIZE;
+    
+    pass_b = 1;
+    ret |= bench_run("pass", 0);
+    pass_b = 0;
+    
+    run_md5_b = 1;
+    ret |= bench_run("md5", 0);
+    run_md5_b = 0;
+    
+    pass_b = 1;
+    write_page_b = 1;
+    ret |= bench_run("write-page", 0);
+    synth_body = esc_buf;
+    synth_body_len = strlen(esc_buf);
+    ret |= bench_run("write-page-escapes", 0);
+    write_page_b = 0;
+    
+    read_page_b = 1;
+    synth_head = esc_start_buf;
+    synth_tail = esc_end_buf;
+    synth_body = random_buf;
+    synth_body_len = BENCH_PATTERN_SIZE;
+    ret |= bench_run("read-page", 0);
+    synth_body = esc_mid_buf;
+    synth_body_len = strlen(esc_mid_buf);
+    ret |= bench_run("read-page-escapes", 0);
+    read_page_b = 0;
+    pass_b = 0;
+    synth_head = "";
+    synth_tail = "";
+    synth_body = random_buf;
+    synth_body_len = BENCH_PATTERN_SIZE;
+    
+    for (file_n_p = file_ns; *file_n_p != 0; file_n_p++) {
+      ret |= bench_run("fanout", *file_n_p);
+    }
+  }
+  
+  /* see how close the throttle gets to its rate */
+  if (ret == 0) {
+    throttle_size = save_throttle;
+    if (throttle_size == 0) {
+      throttle_size = BENCH_THROTTLE;
+    }
+    buf_size = BUFFER_SIZE;
+    bench_size = (unsigned long long)throttle_size * BENCH_THROTTLE_SECS;
+    pass_b = 1;
+    ret |= bench_run("throttle", 0);
+  }
+  
+  free(random_buf);
+  return ret;
+}
+
+int	main(int argc, char **argv)
+{
+  argv_help_string = "Null utility.  Also try --usage.";
+  argv_version_string = NULL_VERSION_STRING;
+  
+  argv_process(args, argc, argv);
+  /* a trace file is no use without the trace */
+  if (trace_path != NULL) {
+    very_verbose_b = 1;
+  }
+  if (very_verbose_b) {
+    verbose_b = 1;
+  }
+  if (flush_out_b) {
+    (void)fprintf(stderr,
+		  "%s: WARNING: -F is deprecated since the output is no longer "
+		  "buffered, use --fsync instead\n",
+		  argv_program);
+  }
+  
+  iobuf_init(huge_pages_b, numa_local_b);
+  
+  if (help_b) {
+    (void)fprintf(stderr, "Null Utility: http://256.com/sources/null/\n");
+    (void)fprintf(stderr,
+                  "  This utility combines the functionality of /dev/null,\n");
+    (void)fprintf(stderr,
+                  "  tee, and md5sum with additional features.\n");
+    (void)fprintf(stderr,
+		  "  For a list of command-line options enter: %s --usage\n",
+                  argv_argv[0]);
+    exit(0);
+  }
+  
+  if (write_page_b && (! pass_b)) {
+    (void)fprintf(stderr,
+		  "%s: disabling write pagination since pass data flag (-%c) "
+		  "disabled\n",
+		  argv_program, PASS_CHAR);
+    write_page_b = 0;
+  }
+
+  if (decode_path != NULL) {
+    int ret = trace_decode(decode_path, stdout);
+    argv_cleanup(args);
+    exit(ret == 0 ? 0 : 1);
+  }
+  
+  if (check_path != NULL) {
+    int ret = sum_check(check_path, job_n, buf_size);
+    argv_cleanup(args);
+    exit(ret == 0 ? 0 : 1);
+  }
+  if (sum_files_b) {
+    int ret;
+    if (inputs.aa_entry_n > 0) {
+      ret = sum_files((char **)inputs.aa_entries, inputs.aa_entry_n, job_n,
+		      buf_size);
     }
     else {
-      speed = (float)read_c / secs;
+      ret = sum_files(NULL, 0, job_n, buf_size);
     }
-    (void)fprintf(stderr, " or %s per sec\n", byte_size(speed, NULL, 0));
+    argv_cleanup(args);
+    exit(ret == 0 ? 0 : 1);
   }
   
-  /* close the output paths */
-  int file_c;
-  for (file_c = 0; file_c < outfiles.aa_entry_n; file_c++) {
-    if (streams[file_c] != NULL) {
-      (void)fclose(streams[file_c]);
+  if (bench_b) {
+    int ret = run_bench();
+    argv_cleanup(args);
+    exit(ret);
+  }
+  
+  parse_outputs();
+  
+  gen_t gen;
+  if (gen_type != NULL) {
+    if (inputs.aa_entry_n > 0) {
+      (void)fprintf(stderr, "%s: input files cannot be used with --generate\n",
+		    argv_program);
+      exit(1);
+    }
+    if (gen_init(&gen, gen_type, gen_pattern, gen_seed) != 0) {
+      (void)fprintf(stderr, "%s: unknown --generate type or empty pattern: %s\n",
+		    argv_program, gen_type);
+      exit(1);
+    }
+    gen_p = &gen;
+  }
+  gen_t verify_gen;
+  if (verify_type != NULL) {
+    if (gen_init(&verify_gen, verify_type, gen_pattern, gen_seed) != 0) {
+      (void)fprintf(stderr, "%s: unknown --verify type or empty pattern: %s\n",
+		    argv_program, verify_type);
+      exit(1);
     }
+    verify_gen_p = &verify_gen;
+  }
+  if (compare_path != NULL && verify_gen_p != NULL) {
+    (void)fprintf(stderr, "%s: --compare and --verify cannot be used together\n",
+		  argv_program);
+    exit(1);
   }
   
-  /* close the input file if not stdin */
-  if (input_fd != STDIN_FD) {
-    (void)close(input_fd);
+  if (stripe_parity_b && stripe_size == 0) {
+    (void)fprintf(stderr, "%s: --stripe-parity needs --stripe-size\n",
+		  argv_program);
+    exit(1);
+  }
+  if (stripe_size > 0 && (! unstripe_b)) {
+    stripe_data_n = outfiles.aa_entry_n - (stripe_parity_b ? 1 : 0);
+    if (stripe_data_n < 1 || sparse_b || rotate_size > 0 || rotate_secs > 0) {
+      (void)fprintf(stderr,
+		    "%s: --stripe-size needs -f data files and no -S or rotation\n",
+		    argv_program);
+      exit(1);
+    }
+    if (stripe_parity_b) {
+      stripe_row = (char *)calloc(1, stripe_size);
+      if (stripe_row == NULL) {
+	perror("malloc");
+	exit(1);
+      }
+    }
+    striping_b = 1;
+  }
+  stripe_read_t stripe_in;
+  if (unstripe_b) {
+    if (stripe_size == 0 || gen_p != NULL) {
+      (void)fprintf(stderr,
+		    "%s: --unstripe needs --stripe-size and the input files\n",
+		    argv_program);
+      exit(1);
+    }
+    if (stripe_open(&stripe_in, (char **)inputs.aa_entries, inputs.aa_entry_n,
+		    stripe_size, stripe_parity_b) != 0) {
+      exit(1);
+    }
+    stripe_in_p = &stripe_in;
+  }
+  
+  fec_t fec_out, fec_in;
+  if (fec_spec != NULL) {
+    int fec_k = 0, fec_m = 0;
+    if (sscanf(fec_spec, "%d,%d", &fec_k, &fec_m) != 2
+	|| fec_k < 1 || fec_m < 1 || fec_k + fec_m > FEC_MAX_BLOCKS) {
+      (void)fprintf(stderr,
+		    "%s: --fec needs K,M data and parity blocks up to %d total\n",
+		    argv_program, FEC_MAX_BLOCKS);
+      exit(1);
+    }
+    if ((! write_page_b) && (! read_page_b)) {
+      (void)fprintf(stderr, "%s: --fec needs -w or -r pagination\n",
+		    argv_program);
+      exit(1);
+    }
+    if (write_page_b && out_block_size > 0) {
+      (void)fprintf(stderr,
+		    "%s: --fec frames can't be cut into --output-block blocks\n",
+		    argv_program);
+      exit(1);
+    }
+    if (read_page_b && (ring_size > 0 || stripe_in_p != NULL
+			|| gen_p != NULL)) {
+      (void)fprintf(stderr,
+		    "%s: --fec with -r reads the input itself so no ring, "
+		    "stripes, or generator\n",
+		    argv_program);
+      exit(1);
+    }
+    if (write_page_b) {
+      if (fec_init(&fec_out, fec_k, fec_m) != 0) {
+	perror("malloc");
+	exit(1);
+      }
+      fec_out_p = &fec_out;
+    }
+    if (read_page_b) {
+      if (fec_init(&fec_in, fec_k, fec_m) != 0) {
+	perror("malloc");
+	exit(1);
+      }
+      fec_in_p = &fec_in;
+    }
   }
   
   /*
-   * We flush the stdout before the md5 is printed to attempt to force
-   * any de-archive messages before.
+   * Output blocks are all written whole so they can't be broken up by
+   * sparse holes or stripes and a rotated file has to end on one.
    */
-  if (pass_b) {
-    (void)fflush(stdout);
+  if (out_block_size > 0 && (sparse_b || (stripe_size > 0 && (! unstripe_b)))) {
+    (void)fprintf(stderr,
+		  "%s: --output-block can't be used with -S or --stripe-size\n",
+		  argv_program);
+    exit(1);
+  }
+  if (out_block_size > 0 && rotate_size % out_block_size != 0) {
+    (void)fprintf(stderr,
+		  "%s: --rotate-size must be a multiple of --output-block\n",
+		  argv_program);
+    exit(1);
   }
   
-  if (run_md5_b) {
-    char md5_result[MD5_SIZE];
-    md5_finish(&md5, md5_result);
-    char md5_string[64];
-    md5_sig_to_string(md5_result, md5_string, sizeof(md5_string));
-    
-    (void)fprintf(stderr, "%s: md5 signature of input = '%s'\n",
-		  argv_program, md5_string);
+  /* the buffer has to hold whole output blocks */
+  if (out_block_size > 0 && buf_size % out_block_size != 0) {
+    buf_size += out_block_size - buf_size % out_block_size;
+  }
+  
+  ring_t ring;
+  if (ring_size > 0) {
+    if (ring_high_pct < 0 || ring_high_pct > 100 || ring_low_pct < 0
+	|| ring_low_pct >= ring_high_pct) {
+      (void)fprintf(stderr,
+		    "%s: --ring-low must be below --ring-high in 0 to 100\n",
+		    argv_program);
+      exit(1);
+    }
+    if (ring_size < buf_size) {
+      ring_size = buf_size;
+    }
+    if (ring_init(&ring, ring_size, ring_high_pct, ring_low_pct) != 0) {
+      (void)fprintf(stderr, "%s: could not allocate %ld bytes for ring\n",
+		    argv_program, ring_size);
+      exit(1);
+    }
+    ring_p = &ring;
+  }
+  
+  /*
+   * With very-verbose we record the i/o into the trace ring instead
+   * of printing a line for each which would slow us down.
+   */
+  if (very_verbose_b) {
+    if (trace_init(trace_path) != 0) {
+      (void)fprintf(stderr, "%s: could not allocate trace ring\n",
+		    argv_program);
+      exit(1);
+    }
+    dump_signal_init(SIGUSR2);
+    (void)atexit(trace_exit);
+  }
+  
+  /* put back the input flags even if we exit on an error */
+  (void)atexit(finish_input);
+  
+  if (metrics_addr != NULL) {
+    metrics_p = metrics_start(metrics_addr, (char **)outfiles.aa_entries,
+			      outfiles.aa_entry_n);
+    if (metrics_p == NULL) {
+      exit(1);
+    }
+    (void)atexit(metrics_exit);
   }
   
-  if (streams != NULL) {
-    free(streams);
+  int ret;
+  if (stripe_in_p != NULL) {
+    ret = transfer(STRIPE_FD);
+    stripe_close(stripe_in_p);
   }
-  free(buf);
+  else if (gen_p == NULL) {
+    ret = transfer(open_input(0));
+  }
+  else {
+    ret = transfer(SYNTH_FD);
+  }
+  
+  if (ring_p != NULL) {
+    ring_free(ring_p);
+  }
+  if (fec_out_p != NULL) {
+    fec_free(fec_out_p);
+  }
+  if (fec_in_p != NULL) {
+    fec_free(fec_in_p);
+  }
+  metrics_exit();
   argv_cleanup(args);
-
-  exit(0);
+  exit(ret);
 }
@@ -23,6 +23,201 @@ cmp x.t z.t
 rm -f x.t y.t z.t
 echo ""
 
+##################################################################
+# -a read all tests
+##################################################################
+
+echo "Checking read all -a argument..."
+rm -f x.t y.t
+cat *.[ch] > x.t
+# small buffer so the input is stored across many reads
+./null -a -b 1k -p --huge-pages x.t > y.t
+cmp x.t y.t
+./null -a -s 1000 -p x.t | wc -c | grep 1000
+# no memory so everything gets spilled to disk
+./null -a -b 1k --all-read-memory 1 --spill-dir . -p -v x.t 2>&1 > y.t \
+    | grep "spilled"
+cmp x.t y.t
+rm -f x.t y.t
+echo ""
+
+##################################################################
+# -S sparse output tests
+##################################################################
+
+echo "Checking sparse -S argument..."
+rm -f x.t y.t z.t
+dd if=/dev/zero of=x.t bs=10k count=10 2> /dev/null
+cat *.[ch] >> x.t
+dd if=/dev/zero bs=10k count=10 >> x.t 2> /dev/null
+# holes should be skipped for a regular file and for a stream
+./null -S -v -f y.t x.t 2>&1 | grep "skipped 1..\..k"
+cat x.t | ./null -S -b 3k -f z.t
+cmp x.t y.t
+cmp x.t z.t
+rm -f x.t y.t z.t
+echo ""
+
+##################################################################
+# --output-mode and --preallocate tests
+##################################################################
+
+echo "Checking --output-mode..."
+rm -f x.t y.t z.t
+cat *.[ch] > z.t
+cat *.[ch] | ./null -f x.t -f y.t,append
+cat *.[ch] | ./null -f x.t,append -f y.t --output-mode append
+# both should have the input twice
+cat z.t z.t | cmp - x.t
+cmp x.t y.t
+# appending with -S should fill in the holes at the end of the file
+dd if=/dev/zero bs=10k count=10 2> /dev/null | ./null -S -f y.t,append
+test `wc -c < y.t` -eq `expr \`wc -c < x.t\` + 102400`
+# an existing excl file should not be touched
+cat *.[ch] | ./null -f x.t,excl 2>&1 | grep "File exists"
+cat z.t z.t | cmp - x.t
+# preallocated files should be truncated back to what we wrote
+rm -f x.t
+cat *.[ch] | ./null -f x.t,excl --prealloc-size 10m
+cmp x.t z.t
+cat *.[ch] | ./null -f x.t -s 1000 --preallocate
+test `wc -c < x.t` -eq 1000
+rm -f x.t y.t z.t
+echo ""
+
+##################################################################
+# --fsync and --sync-every tests
+##################################################################
+
+echo "Checking --fsync..."
+rm -f x.t
+cat *.[ch] | ./null -v --fsync --sync-every 10k -f x.t 2>&1 \
+    | grep "syncing output files"
+cat *.[ch] | cmp - x.t
+# the directory is synced too when the segments are renamed
+rm -f x.t x.t.*
+cat *.[ch] > x.t.all
+cat x.t.all | ./null --fsync --rotate-size 100k -f x.t
+cat `ls x.t.[0-9]* | sort -t. -k3 -n` x.t | cmp - x.t.all
+rm -f x.t.*
+# a write that fails should fail null
+if test -w /dev/full; then
+    if echo hi | ./null -f /dev/full 2> /dev/null; then
+	exit 1
+    fi
+fi
+rm -f x.t
+echo ""
+
+##################################################################
+# --output-errors tests
+##################################################################
+
+if test -w /dev/full; then
+    echo "Checking --output-errors..."
+    rm -f x.t
+    # the full output should be dropped and the others written
+    (cat *.[ch] | ./null -p -f /dev/full,drop -f x.t --output-retries 1 \
+	-f /dev/full,retry || echo $? > x.s) 2>&1 > x.p \
+	| grep -c "dropped /dev/full after"
+    test `cat x.s` -eq 1
+    cat *.[ch] | cmp - x.p
+    cat *.[ch] | cmp - x.t
+    # and the default is to stop
+    rm -f x.s
+    (cat *.[ch] | ./null -f /dev/full -f x.t || echo $? > x.s) 2>&1 \
+	| grep "Could not write to /dev/full"
+    test `cat x.s` -eq 1
+    rm -f x.p x.s x.t
+    echo ""
+fi
+
+##################################################################
+# --rotate tests
+##################################################################
+
+echo "Checking --rotate-size..."
+rm -f x.t x.t.*
+cat *.[ch] | ./null -f x.t --rotate-size 100k
+# the segments should be full sized and put back together to the input
+test `wc -c < x.t.1` -eq 102400
+cat *.[ch] > x.t.all
+cat `ls x.t.[0-9]* | sort -t. -k3 -n` x.t | cmp - x.t.all
+rm -f x.t x.t.*
+echo ""
+
+echo "Checking --rotate-secs with idle input..."
+# the segment should be rotated while the input has nothing more for us
+(echo one; sleep 3; echo two) | ./null -f x.t --rotate-secs 1 &
+sleep 2
+test "`cat x.t.1`" = one
+wait
+rm -f x.t x.t.*
+# a segment that can't be renamed goes through the -f error policy
+(echo one; sleep 3; echo two) | ./null -f x.t,drop --rotate-secs 2 2> x.e &
+sleep 0.5
+mkdir -p x.t.1/sub
+wait $! || echo $? > x.rc
+test "`cat x.rc`" = 1
+grep "could not rename x.t so dropping it" x.e
+rm -rf x.t x.t.* x.e x.rc
+echo ""
+
+##################################################################
+# --generate tests
+##################################################################
+
+echo "Checking --generate..."
+dd if=/dev/zero bs=1k count=100 2> /dev/null > x.t
+./null --generate zeros -s 100k -p | cmp - x.t
+test `./null --generate pattern --pattern ab -s 5 -p` = "ababa"
+# the random stream should not depend on the buffer size but on the seed
+./null --generate random -s 100k -p > x.t
+./null --generate random -s 100k -b 13 -p | cmp - x.t
+if ./null --generate random --seed 1 -s 100k -p | cmp -s - x.t; then
+    exit 1
+fi
+rm -f x.t
+echo ""
+
+echo "Checking --verify..."
+./null --generate random --seed 5 -s 100k -p | ./null --verify random --seed 5
+./null --generate pattern -s 100k -p > x.t
+./null --verify pattern -s 100k x.t
+# corrupt a couple of places and they should be found
+printf XXXX | dd of=x.t bs=1 seek=5000 conv=notrunc 2> /dev/null
+printf Y | dd of=x.t bs=1 seek=90000 conv=notrunc 2> /dev/null
+if ./null --verify pattern x.t 2> x.e; then
+    exit 1
+fi
+grep "differs at offset 5000 for 4 bytes" x.e
+grep "2 ranges .* first at offset 5000" x.e
+# and a short stream
+./null --verify pattern -s 200k x.t 2>&1 | grep "ended after 102400"
+rm -f x.e x.t
+echo ""
+
+echo "Checking --compare..."
+./null --generate random -s 100k -p > x.r
+./null --compare x.r -p < x.r | cmp - x.r
+# compare against something that is not mapped
+cat x.r | ./null --compare /dev/stdin x.r
+cp x.r x.t
+printf XXXX | dd of=x.t bs=1 seek=5000 conv=notrunc 2> /dev/null
+printf Y | dd of=x.t bs=1 seek=90000 conv=notrunc 2> /dev/null
+./null --compare x.r x.t 2> x.e || echo $? > x.s
+test `cat x.s` = 1
+grep "2 ranges .* first at offset 5000" x.e
+# stop at the first difference
+./null --compare x.r --stop-on-diff -b 8k -v x.t 2> x.e || true
+grep "1 ranges .* first at offset 5000" x.e
+grep "processed 8.0k" x.e
+# lengths have to match
+head -c 1000 x.r | ./null --compare x.r 2>&1 | grep "ended at offset 1000"
+(cat x.r; echo extra) | ./null --compare x.r 2>&1 | grep "6 bytes past"
+rm -f x.e x.r x.s x.t
+echo ""
+
 ##################################################################
 # -m md5 signature tests
 ##################################################################
@@ -32,6 +227,64 @@ echo "Checking -m md5 argument..."
 ./null -m 2>&1 /dev/null | grep "d41d8cd98f00b204e9800998ecf8427e"
 echo ""
 
+##################################################################
+# --dedup-stats and --dedup-store tests
+##################################################################
+
+echo "Checking dedup arguments..."
+rm -rf x.t y.t dedup.t
+cat *.[ch] > x.t
+# zeros are cut at the max chunk size and are all the same chunk
+dd if=/dev/zero bs=64k count=16 2> /dev/null \
+    | ./null --dedup-stats -v 2>&1 | grep "16 chunks, 1 unique"
+# the summary is only printed with -v
+test -z "`dd if=/dev/zero bs=64k count=2 2> /dev/null | ./null --dedup-stats 2>&1`"
+# rebuild the stream from the recipe
+cat x.t x.t | ./null --dedup-store dedup.t
+(cd dedup.t && awk '{ print substr($1, 1, 2) "/" $1 }' recipe | xargs cat) > y.t
+cat x.t x.t | cmp - y.t
+rm -rf x.t y.t dedup.t
+echo ""
+
+##################################################################
+# multiple input tests
+##################################################################
+
+echo "Checking multiple inputs..."
+# should be the same as cat'ing them together
+cat null.c md5.c argv.c | ./null -m 2> x.t1
+./null -m --prefetch 1m null.c md5.c argv.c 2> x.t2
+cmp x.t1 x.t2
+./null -f x.t1 null.c argv.c
+cat null.c argv.c | cmp - x.t1
+rm -f x.t1 x.t2
+echo ""
+
+##################################################################
+# --sum-files and --check tests
+##################################################################
+
+echo "Checking --sum-files and --check..."
+# each file should get the same signature as -m gives it
+./null --sum-files -j 2 null.c md5.c | sort > x.t
+grep "  null.c$" x.t | grep `./null -m < null.c 2>&1 | cut -d "'" -f 2`
+printf 'null.c\0md5.c\0' | ./null --sum-files -j 1 | sort | diff - x.t
+./null --check x.t -j 2 | grep -c ": OK"
+# paths with a backslash are escaped in the result lines like md5sum
+cp null.c 'x\y.t'
+./null --sum-files 'x\y.t' > x.t3
+./null --check x.t3 | grep -x '\\x\\\\y.t: OK'
+rm -f 'x\y.t' x.t3
+# a changed signature should fail
+cp x.t x.t2
+echo "00000000000000000000000000000000  null.c" >> x.t2
+if ./null --check x.t2 > /dev/null 2>&1; then
+    echo "--check should have failed"
+    exit 1
+fi
+rm -f x.t x.t2
+echo ""
+
 ##################################################################
 # -s stop-after tests
 ##################################################################
@@ -41,6 +294,19 @@ echo "Checking stop after -s argument..."
 cat *.[ch] | ./null -v -s 100000 2>&1 | grep 100000
 echo ""
 
+##################################################################
+# --bench tests
+##################################################################
+
+echo "Checking --bench..."
+# each case should report a line and md5 should be in there
+./null --bench -s 100k -b 4k -t 1m > x.t
+grep "case=md5 buffer=4096" x.t
+grep "case=fanout buffer=4096 files=4" x.t
+grep "case=throttle" x.t
+rm -f x.t
+echo ""
+
 ##################################################################
 # --help and --usage tests
 ##################################################################
@@ -50,6 +316,177 @@ echo "Checking --help and --usage..."
 ./null --usage 2>&1 | grep -- --help
 echo ""
 
+##################################################################
+# -H histograms tests
+##################################################################
+
+echo "Checking -H histograms..."
+# should see a line for each of the stages that we used
+cat *.[ch] | ./null -H -m -p -f x.t 2>&1 > /dev/null | grep "read .* p999="
+cat *.[ch] | ./null -H -m -p -f x.t 2>&1 > /dev/null | grep "md5 .* p50="
+cat *.[ch] | ./null -H -m -p -f x.t 2>&1 > /dev/null | grep "file x.t .* max="
+rm -f x.t
+echo ""
+
+##################################################################
+# --metrics tests
+##################################################################
+
+if command -v curl > /dev/null; then
+    echo "Checking --metrics..."
+    (cat *.[ch]; sleep 2) | ./null --metrics ./x.sock -p -f x.t > /dev/null &
+    sleep 1
+    curl -s --unix-socket ./x.sock http://localhost/metrics > x.m
+    wait
+    grep "^null_bytes_in_total [1-9]" x.m
+    grep '^null_bytes_out_total{output="x.t"} [1-9]' x.m
+    # the socket should be removed when null finishes
+    test ! -e x.sock
+    # even when it exits on an output error
+    if test -w /dev/full; then
+	echo hi | ./null --metrics ./x.sock -f /dev/full 2> /dev/null || true
+	test ! -e x.sock
+    fi
+    rm -f x.m x.t
+    echo ""
+fi
+
+##################################################################
+# -V trace tests
+##################################################################
+
+echo "Checking -V trace..."
+# the trace should be decoded at the end
+cat *.[ch] | ./null -V -b 10k 2>&1 | grep -c " read 10240 bytes"
+# and written to a file that we can decode
+cat *.[ch] | ./null -V -b 10k --trace-file x.t
+./null --decode-trace x.t | grep -c " wrote 10240 bytes"
+# the trace file turns on -V by itself
+cat *.[ch] | ./null -b 10k --trace-file x.t
+./null --decode-trace x.t | grep -c " wrote 10240 bytes"
+./null --decode-trace null.c 2>&1 | grep "not a null trace file"
+# the mid escape is traced with the paged chars around it
+printf 'xnull-page-y' | ./null -w -p -V 2>&1 > /dev/null \
+    | grep -A1 "wrote 11 paged chars" | grep "wrote mid pagination"
+# -F does nothing now but it should say so
+echo hi | ./null -F 2>&1 | grep "deprecated"
+rm -f x.t
+echo ""
+
+##################################################################
+# -n non-blocking tests
+##################################################################
+
+echo "Checking non-blocking -n..."
+# an input file other than stdin should work
+./null -n -p null.c | cmp - null.c
+# we should report the rate while we are waiting for the input
+(echo hello; sleep 1; echo there) | ./null -n -p -R 0.2 2> x.t | grep there
+grep -c "Writing at 0b per sec" x.t
+# stdin should be blocking again for whoever reads it after us
+(echo one; sleep 1; echo two) | (./null -n -s 4 -p > x.o; cat >> x.o)
+test `cat x.o | wc -l` = 2
+(echo one; sleep 1; echo two) | (./null --busy-poll 100 -s 4 -p > x.o; cat >> x.o)
+test `cat x.o | wc -l` = 2
+rm -f x.o x.t
+echo ""
+
+echo "Checking --busy-poll..."
+(echo one; sleep 1; echo two) | ./null -p --busy-poll 1000 -v 2> x.t > x.o
+test `cat x.o | wc -l` = 2
+grep "forward .* n=2 " x.t
+# without --busy-poll or -H the latency isn't timed
+test -z "`echo hi | ./null -p -v 2>&1 > /dev/null | grep forward`"
+rm -f x.o x.t
+echo ""
+
+echo "Checking --coalesce-size..."
+# records that come in together should be written together
+(echo one; echo two; sleep 1; echo three) \
+    | ./null -p --coalesce-size 64k --coalesce-msecs 100 -H 2> x.t > x.o
+test `cat x.o | wc -l` = 3
+grep "forward .* n=2 " x.t
+# but a full batch goes out right away
+./null --coalesce-size 1k -b 512 -p null.c | cmp - null.c
+rm -f x.o x.t
+echo ""
+
+echo "Checking --ring-size..."
+./null --ring-size 64k -b 1000 -p null.c | cmp - null.c
+# nothing should be written until the ring fills or the input ends
+(echo one; sleep 1; echo two) | ./null --ring-size 1m -p -R 0.2 2> x.t > x.o
+test `cat x.o | wc -l` = 2
+tr '\r' '\n' < x.t | grep "total 0b) ring 0% full"
+# blocks are held back until they are whole
+./null --output-block 1000 -b 1500 -p -V null.c 2> x.t > x.o
+cmp x.o null.c
+test -z "`grep wrote x.t | sed '$d' | grep -v ' [0-9]*000 bytes'`"
+rm -f x.o x.t
+echo ""
+
+echo "Checking --pad-block..."
+test `./null --output-block 1000 --pad-block -p null.c | wc -c` \
+    = $(( (`wc -c < null.c` + 999) / 1000 * 1000 ))
+# with pagination the reader should strip the padding
+./null --output-block 1000 --pad-block -w -p null.c > x.o
+test $(( `wc -c < x.o` % 1000 )) = 0
+./null -r -p x.o | cmp - null.c
+# only the end of the output is padded, not each rotated segment
+head -c 4500 null.c > x.in
+./null --output-block 1000 --pad-block --rotate-size 2000 -f x.o x.in
+test `cat x.o.1 x.o.2 x.o | wc -c` = 5000
+cat x.o.1 x.o.2 x.o | head -c 4500 | cmp - x.in
+# or the end of each of the inputs
+./null --output-block 1000 --pad-block -p x.in x.in > x.o
+test `wc -c < x.o` = 9000
+cat x.in x.in | cmp - x.o
+# throttled writes that catch up after a pause should still be whole blocks
+(head -c 2000 x.in; sleep 1; head -c 4000 x.in) \
+    | ./null --output-block 1000 -t 6k -p -V 2> x.t > x.o
+(head -c 2000 x.in; head -c 4000 x.in) | cmp - x.o
+test -z "`grep wrote x.t | sed '$d' | grep -v ' [0-9]*000 bytes'`"
+rm -f x.in x.o.1 x.o.2 x.t
+# blocks can't be cut by holes or stripes or split across rotations
+./null --output-block 1000 -S -f x.o null.c 2> /dev/null || echo $? > x.rc
+test `cat x.rc` = 1
+./null --output-block 1000 --stripe-size 4k -f x.1 -f x.2 null.c 2> /dev/null \
+    || echo $? > x.rc
+test `cat x.rc` = 1
+./null --output-block 1000 --rotate-size 1500 -f x.o null.c 2> /dev/null \
+    || echo $? > x.rc
+test `cat x.rc` = 1
+rm -f x.o x.rc x.1 x.2
+echo ""
+
+echo "Checking --stripe-size..."
+./null --stripe-size 4k -f x.1 -f x.2 -f x.3 null.c
+test `cat x.1 x.2 x.3 | wc -c` = `wc -c < null.c`
+./null --unstripe --stripe-size 4k x.1 x.2 x.3 -p | cmp - null.c
+# with parity we should be able to lose any one of the data files
+./null --stripe-size 4k --stripe-parity -f x.1 -f x.2 -f x.3 -f x.p null.c
+./null --unstripe --stripe-size 4k --stripe-parity x.1 x.2 x.3 x.p -p \
+    | cmp - null.c
+for lost in x.1 x.2 x.3; do
+    mv $lost x.lost
+    ./null --unstripe --stripe-size 4k --stripe-parity x.1 x.2 x.3 x.p -p \
+	2> /dev/null | cmp - null.c
+    mv x.lost $lost
+done
+# or the parity file itself
+mv x.p x.lost
+./null --unstripe --stripe-size 4k --stripe-parity x.1 x.2 x.3 x.p -p \
+    2> /dev/null | cmp - null.c
+# but not the parity and a data file
+rm x.1
+./null --unstripe --stripe-size 4k --stripe-parity x.1 x.2 x.3 x.p -p \
+    2> /dev/null > /dev/null || echo $? > x.rc
+test `cat x.rc` = 1
+# parity means nothing without stripes
+./null --stripe-parity -f x.1 -f x.p null.c 2> /dev/null || echo $? > x.rc
+test `cat x.rc` = 1
+rm -f x.1 x.2 x.3 x.p x.lost x.rc
+echo ""
+
 ##################################################################
 # -t throttle and rate tests
 ##################################################################
@@ -67,3 +504,41 @@ echo "Checking read and write pagination..."
 # should not get error because tar worked
 tar -czf - . | ./null -w -p | ./null -rpv | tar -tzvf - > /dev/null
 echo ""
+
+echo "Checking --fec..."
+./null -w -p --fec 4,2 null.c > x.o
+./null -r -p --fec 4,2 x.o | cmp - null.c
+# zero parts of two of the 4120 byte data frames in the first group
+dd if=/dev/zero of=x.o bs=1 seek=4220 count=50 conv=notrunc 2> /dev/null
+dd if=/dev/zero of=x.o bs=1 seek=8270 count=50 conv=notrunc 2> /dev/null
+./null -r -p --fec 4,2 -v x.o 2> x.t | cmp - null.c
+grep "rebuilt 2 data blocks in 1 of" x.t
+# a third bad frame in the group is more than the parity can fix
+dd if=/dev/zero of=x.o bs=1 seek=20630 count=50 conv=notrunc 2> /dev/null
+./null -r -p --fec 4,2 x.o > /dev/null 2> x.t || echo $? > x.rc
+test "`cat x.rc`" = 1
+grep "3 bad blocks" x.t
+# damaged parity doesn't need any data rebuilt
+./null -w -p --fec 4,2 null.c > x.o
+dd if=/dev/zero of=x.o bs=1 seek=20630 count=50 conv=notrunc 2> /dev/null
+./null -r -p --fec 4,2 -v x.o 2> x.t | cmp - null.c
+grep "rebuilt 0 data blocks in 0 of" x.t
+# a frame or part of one lost from the middle should be skipped over
+./null -w -p --fec 4,2 null.c > x.o
+(head -c 4120 x.o; tail -c +8241 x.o) | ./null -r -p --fec 4,2 -v 2> x.t \
+    | cmp - null.c
+grep "rebuilt 1 data blocks in 1 of" x.t
+(head -c 5000 x.o; tail -c +5101 x.o) | ./null -r -p --fec 4,2 | cmp - null.c
+# a slow non-blocking input should pick each group up where it left off
+./null -w -p --fec 4,2 null.c > x.o
+split -b 7000 x.o x.s.
+(for part in x.s.*; do cat $part; sleep 0.05; done) \
+    | ./null -r -p -n --fec 4,2 | cmp - null.c
+(for part in x.s.*; do cat $part; sleep 0.05; done) \
+    | ./null -r -p --busy-poll 10 --fec 4,2 | cmp - null.c
+rm -f x.s.*
+# a cut off last frame should be rebuilt
+./null -w -p --fec 4,2 null.c > x.o
+head -c $(( `wc -c < x.o` - 10 )) x.o | ./null -r -p --fec 4,2 | cmp - null.c
+rm -f x.o x.t x.rc
+echo ""
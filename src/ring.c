@@ -0,0 +1,217 @@
+/*
+ * Elastic ring buffer routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * A tape drive has to be kept streaming or it stops, rewinds, and
+ * starts again for every stall of the program feeding it.  The ring
+ * soaks up the stalls: the input is read into it without blocking
+ * whenever null gets a chance and bytes are only handed on once it
+ * has filled to the high water mark.  When it runs down to the low
+ * mark we wait for it to fill again instead of trickling out.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "iobuf.h"
+#include "ring.h"
+
+/*
+ * int ring_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a ring with iobuf_alloc and set its water marks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the ring.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Pointer to the ring we are initializing.
+ *
+ * size -> Size of the ring in bytes.
+ *
+ * high_pct -> Percentage full the ring has to get before we start
+ * handing out bytes.
+ *
+ * low_pct -> Percentage full at which we stop handing out bytes and
+ * wait for the ring to fill back up to the high mark.
+ */
+int	ring_init(ring_t *ring_p, const unsigned long size, const int high_pct,
+		  const int low_pct)
+{
+  memset(ring_p, 0, sizeof(*ring_p));
+  ring_p->ri_buf = (char *)iobuf_alloc(size);
+  if (ring_p->ri_buf == NULL) {
+    return -1;
+  }
+  ring_p->ri_size = size;
+  ring_p->ri_high = (unsigned long long)size * high_pct / 100;
+  ring_p->ri_low = (unsigned long long)size * low_pct / 100;
+  return 0;
+}
+
+/*
+ * int ring_read
+ *
+ * DESCRIPTION:
+ *
+ * Pull what a non-blocking input has into the ring and then copy
+ * bytes out of it if we are between the water marks.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes copied into the buffer or 0 if the input
+ * reached EOF and the ring is empty.
+ *
+ * Failure - -1 with errno set to EAGAIN if we are waiting for the
+ * input to fill the ring or to another error from read.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are reading from.
+ *
+ * fd -> Non-blocking input file descriptor.
+ *
+ * buf -> Buffer we are copying into.
+ *
+ * buf_len -> Maximum number of bytes to copy.
+ */
+int	ring_read(ring_t *ring_p, const int fd, char *buf,
+		  const unsigned long buf_len)
+{
+  unsigned long	fill, pos, len;
+  long		ret;
+
+  /* top up the ring with whatever the input has for us */
+  while ((! ring_p->ri_eof_b)
+	 && ring_p->ri_in - ring_p->ri_out < ring_p->ri_size) {
+    pos = ring_p->ri_in % ring_p->ri_size;
+    len = ring_p->ri_size - (ring_p->ri_in - ring_p->ri_out);
+    if (len > ring_p->ri_size - pos) {
+      len = ring_p->ri_size - pos;
+    }
+    ret = read(fd, ring_p->ri_buf + pos, len);
+    if (ret > 0) {
+      ring_p->ri_in += ret;
+    }
+    else if (ret == 0) {
+      ring_p->ri_eof_b = 1;
+    }
+    else if (errno == EINTR) {
+      continue;
+    }
+    else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    }
+    else {
+      return -1;
+    }
+  }
+
+  fill = ring_p->ri_in - ring_p->ri_out;
+  if (ring_p->ri_draining_b) {
+    if (fill <= ring_p->ri_low && (! ring_p->ri_eof_b)) {
+      ring_p->ri_draining_b = 0;
+    }
+  }
+  else if (fill >= ring_p->ri_high || ring_p->ri_eof_b) {
+    ring_p->ri_draining_b = 1;
+  }
+
+  if (ring_p->ri_draining_b && fill > 0) {
+    pos = ring_p->ri_out % ring_p->ri_size;
+    len = fill;
+    if (len > ring_p->ri_size - pos) {
+      len = ring_p->ri_size - pos;
+    }
+    if (len > buf_len) {
+      len = buf_len;
+    }
+    memcpy(buf, ring_p->ri_buf + pos, len);
+    ring_p->ri_out += len;
+    return len;
+  }
+
+  if (ring_p->ri_eof_b) {
+    /* get ready for the next input if there is one */
+    ring_p->ri_eof_b = 0;
+    ring_p->ri_draining_b = 0;
+    return 0;
+  }
+
+  errno = EAGAIN;
+  return -1;
+}
+
+/*
+ * int ring_fill_pct
+ *
+ * DESCRIPTION:
+ *
+ * Return how full the ring is.
+ *
+ * RETURNS:
+ *
+ * Percentage of the ring that holds bytes to be handed out.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are checking.
+ */
+int	ring_fill_pct(const ring_t *ring_p)
+{
+  return (ring_p->ri_in - ring_p->ri_out) * 100 / ring_p->ri_size;
+}
+
+/*
+ * void ring_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the memory of a ring.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are freeing.
+ */
+void	ring_free(ring_t *ring_p)
+{
+  if (ring_p->ri_buf != NULL) {
+    iobuf_free(ring_p->ri_buf, ring_p->ri_size);
+    ring_p->ri_buf = NULL;
+  }
+}
@@ -0,0 +1,138 @@
+/*
+ * Elastic ring buffer defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __RING_H__
+#define __RING_H__
+
+/*
+ * A large ring of input bytes between the input and the rest of
+ * null.  Once it fills to the high water mark we hand bytes out until
+ * it drops to the low water mark and then wait for it to fill again.
+ */
+typedef struct {
+  char			*ri_buf;		/* ring memory */
+  unsigned long		ri_size;		/* size of the ring */
+  unsigned long		ri_high;		/* start handing out at */
+  unsigned long		ri_low;			/* stop handing out at */
+  unsigned long long	ri_in;			/* total bytes read in */
+  unsigned long long	ri_out;			/* total bytes handed out */
+  int			ri_draining_b;		/* handing out bytes */
+  int			ri_eof_b;		/* input reached EOF */
+} ring_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int ring_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a ring with iobuf_alloc and set its water marks.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the ring.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Pointer to the ring we are initializing.
+ *
+ * size -> Size of the ring in bytes.
+ *
+ * high_pct -> Percentage full the ring has to get before we start
+ * handing out bytes.
+ *
+ * low_pct -> Percentage full at which we stop handing out bytes and
+ * wait for the ring to fill back up to the high mark.
+ */
+extern
+int	ring_init(ring_t *ring_p, const unsigned long size, const int high_pct,
+		  const int low_pct);
+
+/*
+ * int ring_read
+ *
+ * DESCRIPTION:
+ *
+ * Pull what a non-blocking input has into the ring and then copy
+ * bytes out of it if we are between the water marks.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes copied into the buffer or 0 if the input
+ * reached EOF and the ring is empty.
+ *
+ * Failure - -1 with errno set to EAGAIN if we are waiting for the
+ * input to fill the ring or to another error from read.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are reading from.
+ *
+ * fd -> Non-blocking input file descriptor.
+ *
+ * buf -> Buffer we are copying into.
+ *
+ * buf_len -> Maximum number of bytes to copy.
+ */
+extern
+int	ring_read(ring_t *ring_p, const int fd, char *buf,
+		  const unsigned long buf_len);
+
+/*
+ * int ring_fill_pct
+ *
+ * DESCRIPTION:
+ *
+ * Return how full the ring is.
+ *
+ * RETURNS:
+ *
+ * Percentage of the ring that holds bytes to be handed out.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are checking.
+ */
+extern
+int	ring_fill_pct(const ring_t *ring_p);
+
+/*
+ * void ring_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the memory of a ring.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * ring_p -> Ring that we are freeing.
+ */
+extern
+void	ring_free(ring_t *ring_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __RING_H__ */
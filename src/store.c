@@ -0,0 +1,460 @@
+/*
+ * Segmented data store routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * This is used by the read-all (-a) mode to hold the input until it
+ * has all been read.  We used to realloc one big buffer which copied
+ * everything read so far each time it grew and which ran the system
+ * out of memory with large inputs.  Now we keep segments in memory up
+ * to a limit and then spill the rest to a temporary file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "iobuf.h"
+#include "store.h"
+
+#define SPILL_TEMPLATE	"%s/null-spill.XXXXXX"	/* spill file path */
+#define SPILL_DEFAULT_DIR	"/tmp"		/* if no TMPDIR */
+
+/*
+ * static store_seg_t *seg_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new segment and add it to the end of the store.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the new segment.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are growing.
+ */
+static	store_seg_t	*seg_alloc(store_t *store_p)
+{
+  store_seg_t	*seg_p;
+
+  seg_p = (store_seg_t *)malloc(sizeof(store_seg_t));
+  if (seg_p == NULL) {
+    return NULL;
+  }
+  seg_p->ss_buf = iobuf_alloc(store_p->st_seg_size);
+  if (seg_p->ss_buf == NULL) {
+    free(seg_p);
+    return NULL;
+  }
+  seg_p->ss_next_p = NULL;
+  seg_p->ss_len = 0;
+
+  if (store_p->st_last_p == NULL) {
+    store_p->st_first_p = seg_p;
+  }
+  else {
+    store_p->st_last_p->ss_next_p = seg_p;
+  }
+  store_p->st_last_p = seg_p;
+  store_p->st_mem_used += store_p->st_seg_size;
+
+  return seg_p;
+}
+
+/*
+ * Free the first segment in the store.
+ */
+static	void	seg_free_first(store_t *store_p)
+{
+  store_seg_t	*seg_p = store_p->st_first_p;
+
+  store_p->st_first_p = seg_p->ss_next_p;
+  if (store_p->st_first_p == NULL) {
+    store_p->st_last_p = NULL;
+  }
+  store_p->st_read_pos = 0;
+  store_p->st_mem_used -= store_p->st_seg_size;
+
+  iobuf_free(seg_p->ss_buf, store_p->st_seg_size);
+  free(seg_p);
+}
+
+/*
+ * static int spill_open
+ *
+ * DESCRIPTION:
+ *
+ * Create the spill file.  It is unlinked right away so it goes away
+ * when we exit however we exit.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store that is spilling.
+ */
+static	int	spill_open(store_t *store_p)
+{
+  char		path[1024];
+  const char	*dir = store_p->st_spill_dir;
+
+  if (dir == NULL) {
+    dir = getenv("TMPDIR");
+  }
+  if (dir == NULL || *dir == '\0') {
+    dir = SPILL_DEFAULT_DIR;
+  }
+  (void)snprintf(path, sizeof(path), SPILL_TEMPLATE, dir);
+
+#if HAVE_MKSTEMP
+  store_p->st_spill_fd = mkstemp(path);
+#else
+  store_p->st_spill_fd = open(mktemp(path), O_RDWR | O_CREAT | O_EXCL, 0600);
+#endif
+  if (store_p->st_spill_fd < 0) {
+    return -1;
+  }
+  (void)unlink(path);
+  return 0;
+}
+
+/*
+ * static int spill_write
+ *
+ * DESCRIPTION:
+ *
+ * Append bytes to the end of the spill file.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store that is spilling.
+ *
+ * buf -> Buffer of bytes we are spilling.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+static	int	spill_write(store_t *store_p, const char *buf,
+			    const unsigned long buf_len)
+{
+  unsigned long	left = buf_len;
+
+  if (store_p->st_spill_fd < 0 && spill_open(store_p) != 0) {
+    return -1;
+  }
+
+  /* we only ever append and all reads use pread so no seeking here */
+  while (left > 0) {
+    long write_n = write(store_p->st_spill_fd, buf, left);
+    if (write_n < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      return -1;
+    }
+    buf += write_n;
+    left -= write_n;
+  }
+  store_p->st_spill_size += buf_len;
+
+  return 0;
+}
+
+/*
+ * static long spill_read
+ *
+ * DESCRIPTION:
+ *
+ * Read bytes from the current read position of the spill file.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes read, 0 if none left.
+ *
+ * Failure - -1
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store that has spilled.
+ *
+ * buf <- Buffer that we are reading into.
+ *
+ * buf_len -> Maximum number of bytes to read.
+ */
+static	long	spill_read(store_t *store_p, char *buf,
+			   const unsigned long buf_len)
+{
+  unsigned long long	left = store_p->st_spill_size - store_p->st_spill_pos;
+  unsigned long		read_size = buf_len;
+  long			read_n;
+
+  if (left == 0) {
+    return 0;
+  }
+  if (read_size > left) {
+    read_size = left;
+  }
+
+#if HAVE_POSIX_FADVISE && defined(POSIX_FADV_SEQUENTIAL)
+  if (store_p->st_spill_pos == 0) {
+    /* we read it back in order so ask for aggressive read-ahead */
+    (void)posix_fadvise(store_p->st_spill_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+#endif
+
+  do {
+#if HAVE_PREAD
+    read_n = pread(store_p->st_spill_fd, buf, read_size,
+		   store_p->st_spill_pos);
+#else
+    if (lseek(store_p->st_spill_fd, store_p->st_spill_pos, SEEK_SET) < 0) {
+      return -1;
+    }
+    read_n = read(store_p->st_spill_fd, buf, read_size);
+#endif
+  } while (read_n < 0 && errno == EINTR);
+
+  if (read_n > 0) {
+    store_p->st_spill_pos += read_n;
+  }
+  return read_n;
+}
+
+/*
+ * void store_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize a store structure.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are initializing.
+ *
+ * seg_size -> Size of each of the segments that we allocate.
+ *
+ * mem_max -> Maximum amount of segment memory to use before we spill
+ * to disk.  0 means no limit.
+ *
+ * spill_dir -> Directory where we create the spill file.  If NULL
+ * then $TMPDIR or /tmp is used.
+ */
+void	store_init(store_t *store_p, const unsigned long seg_size,
+		   const unsigned long long mem_max, const char *spill_dir)
+{
+  store_p->st_seg_size = seg_size;
+  store_p->st_first_p = NULL;
+  store_p->st_last_p = NULL;
+  store_p->st_read_pos = 0;
+  store_p->st_total = 0;
+  store_p->st_mem_max = mem_max;
+  store_p->st_mem_used = 0;
+  store_p->st_spill_dir = spill_dir;
+  store_p->st_spill_fd = -1;
+  store_p->st_spill_size = 0;
+  store_p->st_spill_pos = 0;
+}
+
+/*
+ * int store_write
+ *
+ * DESCRIPTION:
+ *
+ * Append bytes to the end of the store.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate a segment or write to the
+ * spill file.  errno will be set.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are appending to.
+ *
+ * buf -> Buffer of bytes we are storing.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+int	store_write(store_t *store_p, const char *buf,
+		    const unsigned long buf_len)
+{
+  const char	*buf_p = buf;
+  unsigned long	left = buf_len;
+  store_seg_t	*seg_p = store_p->st_last_p;
+
+  while (left > 0) {
+
+    /* once we have spilled, everything else has to go after it */
+    if (store_p->st_spill_size > store_p->st_spill_pos) {
+      if (spill_write(store_p, buf_p, left) != 0) {
+	return -1;
+      }
+      break;
+    }
+
+    if (seg_p == NULL || seg_p->ss_len == store_p->st_seg_size) {
+      if (store_p->st_mem_max > 0
+	  && store_p->st_mem_used + store_p->st_seg_size > store_p->st_mem_max) {
+	if (spill_write(store_p, buf_p, left) != 0) {
+	  return -1;
+	}
+	break;
+      }
+      seg_p = seg_alloc(store_p);
+      if (seg_p == NULL) {
+	errno = ENOMEM;
+	return -1;
+      }
+    }
+
+    unsigned long copy_len = store_p->st_seg_size - seg_p->ss_len;
+    if (copy_len > left) {
+      copy_len = left;
+    }
+    memcpy(seg_p->ss_buf + seg_p->ss_len, buf_p, copy_len);
+    seg_p->ss_len += copy_len;
+    buf_p += copy_len;
+    left -= copy_len;
+  }
+
+  store_p->st_total += buf_len;
+  return 0;
+}
+
+/*
+ * long store_read
+ *
+ * DESCRIPTION:
+ *
+ * Read bytes from the front of the store.  Segments are freed as soon
+ * as they have been completely read.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes copied into the buffer, 0 on the end of
+ * the store.
+ *
+ * Failure - -1 if the read from the spill file failed.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are reading from.
+ *
+ * buf <- Buffer that we are reading into.
+ *
+ * buf_len -> Maximum number of bytes to read.
+ */
+long	store_read(store_t *store_p, char *buf, const unsigned long buf_len)
+{
+  unsigned long	read_len = 0;
+
+  while (read_len < buf_len && store_p->st_first_p != NULL) {
+    store_seg_t *seg_p = store_p->st_first_p;
+
+    unsigned long copy_len = seg_p->ss_len - store_p->st_read_pos;
+    if (copy_len > buf_len - read_len) {
+      copy_len = buf_len - read_len;
+    }
+    memcpy(buf + read_len, seg_p->ss_buf + store_p->st_read_pos, copy_len);
+    store_p->st_read_pos += copy_len;
+    read_len += copy_len;
+
+    /* free the segment once it has been read unless still being written */
+    if (store_p->st_read_pos == seg_p->ss_len
+	&& (seg_p->ss_next_p != NULL
+	    || seg_p->ss_len == store_p->st_seg_size
+	    || store_p->st_spill_size > 0)) {
+      seg_free_first(store_p);
+    }
+    else if (store_p->st_read_pos == seg_p->ss_len) {
+      break;
+    }
+  }
+
+  /* the memory segments come first and then whatever was spilled */
+  if (read_len < buf_len && store_p->st_first_p == NULL
+      && store_p->st_spill_fd >= 0) {
+    long read_n = spill_read(store_p, buf + read_len, buf_len - read_len);
+    if (read_n < 0) {
+      return -1;
+    }
+    read_len += read_n;
+  }
+
+  return read_len;
+}
+
+/*
+ * void store_clear
+ *
+ * DESCRIPTION:
+ *
+ * Free all of the segments in the store and close the spill file.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are clearing.
+ */
+void	store_clear(store_t *store_p)
+{
+  while (store_p->st_first_p != NULL) {
+    seg_free_first(store_p);
+  }
+  if (store_p->st_spill_fd >= 0) {
+    (void)close(store_p->st_spill_fd);
+    store_p->st_spill_fd = -1;
+  }
+  store_p->st_total = 0;
+  store_p->st_spill_size = 0;
+  store_p->st_spill_pos = 0;
+}
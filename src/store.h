@@ -0,0 +1,157 @@
+/*
+ * Segmented data store defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __STORE_H__
+#define __STORE_H__
+
+/* default size of each of the segments in the store */
+#define STORE_SEGMENT_SIZE	(8UL * 1024UL * 1024UL)
+
+/*
+ * One segment of stored data.  Segments are chained together in the
+ * order that they were written.
+ */
+typedef struct store_seg_st {
+  struct store_seg_st	*ss_next_p;		/* next segment in chain */
+  unsigned long		ss_len;			/* bytes used in segment */
+  char			*ss_buf;		/* segment data */
+} store_seg_t;
+
+/*
+ * A first-in, first-out store of bytes which grows one segment at a
+ * time so we never have to copy what has already been stored.  Once
+ * the segments use up the memory limit, the rest of the bytes are
+ * spilled to an unlinked temporary file.
+ */
+typedef struct {
+  unsigned long		st_seg_size;		/* size of each segment */
+  store_seg_t		*st_first_p;		/* first segment to read */
+  store_seg_t		*st_last_p;		/* last segment written */
+  unsigned long		st_read_pos;		/* read offset in first */
+  unsigned long long	st_total;		/* total bytes written */
+  unsigned long long	st_mem_max;		/* max segment mem, 0 none */
+  unsigned long long	st_mem_used;		/* segment memory in use */
+  const char		*st_spill_dir;		/* where spill file goes */
+  int			st_spill_fd;		/* spill file or -1 */
+  unsigned long long	st_spill_size;		/* bytes written to spill */
+  unsigned long long	st_spill_pos;		/* read offset in spill */
+} store_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void store_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize a store structure.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are initializing.
+ *
+ * seg_size -> Size of each of the segments that we allocate.
+ *
+ * mem_max -> Maximum amount of segment memory to use before we spill
+ * to disk.  0 means no limit.
+ *
+ * spill_dir -> Directory where we create the spill file.  If NULL
+ * then $TMPDIR or /tmp is used.
+ */
+extern
+void	store_init(store_t *store_p, const unsigned long seg_size,
+		   const unsigned long long mem_max, const char *spill_dir);
+
+/*
+ * int store_write
+ *
+ * DESCRIPTION:
+ *
+ * Append bytes to the end of the store.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate a segment or write to the
+ * spill file.  errno will be set.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are appending to.
+ *
+ * buf -> Buffer of bytes we are storing.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+extern
+int	store_write(store_t *store_p, const char *buf,
+		    const unsigned long buf_len);
+
+/*
+ * long store_read
+ *
+ * DESCRIPTION:
+ *
+ * Read bytes from the front of the store.  Segments are freed as soon
+ * as they have been completely read.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes copied into the buffer, 0 on the end of
+ * the store.
+ *
+ * Failure - -1 if the read from the spill file failed.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are reading from.
+ *
+ * buf <- Buffer that we are reading into.
+ *
+ * buf_len -> Maximum number of bytes to read.
+ */
+extern
+long	store_read(store_t *store_p, char *buf, const unsigned long buf_len);
+
+/*
+ * void store_clear
+ *
+ * DESCRIPTION:
+ *
+ * Free all of the segments in the store and close the spill file.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * store_p -> Pointer to the store we are clearing.
+ */
+extern
+void	store_clear(store_t *store_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __STORE_H__ */
@@ -0,0 +1,390 @@
+/*
+ * Striped files routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * With --stripe-size the -f files each get every Nth chunk of the
+ * stream instead of all of it so N disks share the writing.  An
+ * optional parity file holds the xor of each row of chunks, padded
+ * with zeros, and ends with the length of the stream so that a lost
+ * data file, even one holding the short last chunk, can be rebuilt.
+ * Reading the stream back asks the kernel to read ahead on all of the
+ * files at once so the disks are busy in parallel.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <sys/stat.h>
+
+#include "argv.h"
+#include "stripe.h"
+
+#define READ_AHEAD_ROWS		8	/* rows to ask for ahead of us */
+#define NO_ROW			(~0ULL)	/* nothing rebuilt yet */
+
+/*
+ * Read from an offset in a file until we have len bytes or reach its
+ * end.  Returns the bytes read or -1 on error.
+ */
+static	long	read_at(const int fd, char *buf, const unsigned long len,
+			const unsigned long long offset)
+{
+  unsigned long	got = 0;
+  long		ret;
+
+  while (got < len) {
+#if HAVE_PREAD
+    ret = pread(fd, buf + got, len - got, offset + got);
+#else
+    if (lseek(fd, offset + got, SEEK_SET) < 0) {
+      return -1;
+    }
+    ret = read(fd, buf + got, len - got);
+#endif
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      return -1;
+    }
+    if (ret == 0) {
+      break;
+    }
+    got += ret;
+  }
+  return got;
+}
+
+/*
+ * Rebuild a row's chunk of the lost data file from the parity and
+ * the rest of the row into sr_chunk.  Returns 0 on success or -1.
+ */
+static	int	rebuild_chunk(stripe_read_t *stripe_p,
+			      const unsigned long long row)
+{
+  unsigned long long	offset = row * stripe_p->sr_size;
+  char			*tmp = stripe_p->sr_chunk + stripe_p->sr_size;
+  long			ret;
+  int			file_c;
+
+  ret = read_at(stripe_p->sr_parity_fd, stripe_p->sr_chunk,
+		stripe_p->sr_size, offset);
+  if (ret < (long)stripe_p->sr_size) {
+    if (ret >= 0) {
+      errno = EIO;
+    }
+    return -1;
+  }
+  for (file_c = 0; file_c < stripe_p->sr_data_n; file_c++) {
+    if (file_c == stripe_p->sr_missing) {
+      continue;
+    }
+    ret = read_at(stripe_p->sr_fds[file_c], tmp, stripe_p->sr_size, offset);
+    if (ret < 0) {
+      return -1;
+    }
+    /* the short or missing chunks at the end were xor-ed as zeros */
+    memset(tmp + ret, 0, stripe_p->sr_size - ret);
+    stripe_xor(stripe_p->sr_chunk, tmp, stripe_p->sr_size);
+  }
+  stripe_p->sr_chunk_row = row;
+  return 0;
+}
+
+/*
+ * Ask for the chunks ahead of a row on all of the files so the disks
+ * read them at the same time.
+ */
+static	void	read_ahead(stripe_read_t *stripe_p, const unsigned long long row)
+{
+#if HAVE_POSIX_FADVISE && defined(POSIX_FADV_WILLNEED)
+  unsigned long long	until = row + READ_AHEAD_ROWS;
+  int			file_c;
+
+  if (stripe_p->sr_ahead >= until) {
+    return;
+  }
+  if (stripe_p->sr_ahead < row) {
+    stripe_p->sr_ahead = row;
+  }
+  for (file_c = 0; file_c <= stripe_p->sr_data_n; file_c++) {
+    int fd = stripe_p->sr_fds[file_c];
+    if (fd >= 0 && (file_c < stripe_p->sr_data_n
+		    || stripe_p->sr_missing >= 0)) {
+      (void)posix_fadvise(fd, stripe_p->sr_ahead * stripe_p->sr_size,
+			  (until - stripe_p->sr_ahead) * stripe_p->sr_size,
+			  POSIX_FADV_WILLNEED);
+    }
+  }
+  stripe_p->sr_ahead = until;
+#endif
+}
+
+/*
+ * void stripe_xor
+ *
+ * DESCRIPTION:
+ *
+ * Exclusive-or a buffer into another.  This works a word at a time
+ * so the compiler can vectorize it.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * dest <-> Buffer that we are xor-ing into.
+ *
+ * src -> Buffer that we are xor-ing with.
+ *
+ * len -> Number of bytes to xor.
+ */
+void	stripe_xor(char *dest, const char *src, const unsigned long len)
+{
+  unsigned long	pos = 0, word;
+
+  for (; pos + sizeof(word) <= len; pos += sizeof(word)) {
+    unsigned long	dest_word;
+    memcpy(&dest_word, dest + pos, sizeof(word));
+    memcpy(&word, src + pos, sizeof(word));
+    dest_word ^= word;
+    memcpy(dest + pos, &dest_word, sizeof(word));
+  }
+  for (; pos < len; pos++) {
+    dest[pos] ^= src[pos];
+  }
+}
+
+/*
+ * int stripe_open
+ *
+ * DESCRIPTION:
+ *
+ * Open the stripe files for reading the stream back.  If there is a
+ * parity file then one of the data files may be missing and its
+ * chunks are rebuilt from the others, or the parity file itself may
+ * be missing and the data files are read without it.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 with the error printed.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Pointer to the state we are setting up.
+ *
+ * paths -> Paths of the data files in order followed by the parity
+ * file if parity_b.
+ *
+ * path_n -> Number of paths.
+ *
+ * size -> Size of each of the chunks.
+ *
+ * parity_b -> Set to 1 if the last path is the parity file.
+ */
+int	stripe_open(stripe_read_t *stripe_p, char **paths, const int path_n,
+		    const unsigned long size, const int parity_b)
+{
+  int	file_c;
+
+  memset(stripe_p, 0, sizeof(*stripe_p));
+  stripe_p->sr_size = size;
+  stripe_p->sr_data_n = path_n - (parity_b ? 1 : 0);
+  stripe_p->sr_missing = -1;
+  stripe_p->sr_parity_fd = -1;
+  stripe_p->sr_chunk_row = NO_ROW;
+  if (stripe_p->sr_data_n < 1) {
+    (void)fprintf(stderr, "%s: need at least one stripe data file\n",
+		  argv_program);
+    return -1;
+  }
+
+  /* one more so read_ahead can treat the parity like the others */
+  stripe_p->sr_fds = (int *)malloc(sizeof(int) * (stripe_p->sr_data_n + 1));
+  stripe_p->sr_chunk = (char *)malloc(size * 2);
+  if (stripe_p->sr_fds == NULL || stripe_p->sr_chunk == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate stripe buffers\n",
+		  argv_program);
+    return -1;
+  }
+  stripe_p->sr_fds[stripe_p->sr_data_n] = -1;
+
+  for (file_c = 0; file_c < path_n; file_c++) {
+    int fd = open(paths[file_c], O_RDONLY, 0);
+    if (fd < 0 && parity_b && errno == ENOENT && stripe_p->sr_missing < 0
+	&& file_c < stripe_p->sr_data_n) {
+      /* we can do without one of the data files */
+      (void)fprintf(stderr, "%s: rebuilding missing stripe %s from parity\n",
+		    argv_program, paths[file_c]);
+      stripe_p->sr_missing = file_c;
+    }
+    else if (fd < 0 && parity_b && errno == ENOENT && stripe_p->sr_missing < 0
+	     && file_c == stripe_p->sr_data_n) {
+      /* all of the data is there so we don't need the parity */
+      (void)fprintf(stderr, "%s: reading stripes without missing parity %s\n",
+		    argv_program, paths[file_c]);
+    }
+    else if (fd < 0) {
+      (void)fprintf(stderr, "%s: cannot open(%s): %s\n",
+		    argv_program, paths[file_c], strerror(errno));
+      return -1;
+    }
+    stripe_p->sr_fds[file_c] = fd;
+  }
+
+  if (parity_b && stripe_p->sr_fds[stripe_p->sr_data_n] >= 0) {
+    struct stat		statbuf;
+    unsigned char	trailer[STRIPE_TRAILER_SIZE];
+    int			byte_c;
+
+    stripe_p->sr_parity_fd = stripe_p->sr_fds[stripe_p->sr_data_n];
+    if (fstat(stripe_p->sr_parity_fd, &statbuf) != 0
+	|| statbuf.st_size < STRIPE_TRAILER_SIZE
+	|| (statbuf.st_size - STRIPE_TRAILER_SIZE) % size != 0
+	|| read_at(stripe_p->sr_parity_fd, (char *)trailer, sizeof(trailer),
+		   statbuf.st_size - STRIPE_TRAILER_SIZE) != sizeof(trailer)) {
+      (void)fprintf(stderr,
+		    "%s: %s is not a parity file with %lu byte chunks\n",
+		    argv_program, paths[stripe_p->sr_data_n], size);
+      return -1;
+    }
+    for (byte_c = 0; byte_c < STRIPE_TRAILER_SIZE; byte_c++) {
+      stripe_p->sr_total = (stripe_p->sr_total << 8) | trailer[byte_c];
+    }
+  }
+  return 0;
+}
+
+/*
+ * int stripe_read
+ *
+ * DESCRIPTION:
+ *
+ * Read the next bytes of the stream from the stripe files.  We stop
+ * at the end of the chunk that we are in.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes read or 0 at the end of the stream.
+ *
+ * Failure - -1 with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Stripe files that we are reading.
+ *
+ * buf -> Buffer we are reading into.
+ *
+ * buf_len -> Size of the buffer.
+ */
+int	stripe_read(stripe_read_t *stripe_p, char *buf,
+		    const unsigned long buf_len)
+{
+  unsigned long long	chunk = stripe_p->sr_pos / stripe_p->sr_size;
+  unsigned long long	row = chunk / stripe_p->sr_data_n;
+  unsigned long		in_chunk = stripe_p->sr_pos % stripe_p->sr_size;
+  int			file_c = chunk % stripe_p->sr_data_n;
+  unsigned long		len = stripe_p->sr_size - in_chunk;
+  long			ret;
+
+  if (stripe_p->sr_parity_fd >= 0) {
+    if (stripe_p->sr_pos >= stripe_p->sr_total) {
+      return 0;
+    }
+    if (len > stripe_p->sr_total - stripe_p->sr_pos) {
+      len = stripe_p->sr_total - stripe_p->sr_pos;
+    }
+  }
+  if (len > buf_len) {
+    len = buf_len;
+  }
+  read_ahead(stripe_p, row);
+
+  if (file_c == stripe_p->sr_missing) {
+    if (stripe_p->sr_chunk_row != row && rebuild_chunk(stripe_p, row) != 0) {
+      return -1;
+    }
+    memcpy(buf, stripe_p->sr_chunk + in_chunk, len);
+    ret = len;
+  }
+  else {
+    ret = read_at(stripe_p->sr_fds[file_c], buf, len,
+		  row * stripe_p->sr_size + in_chunk);
+    if (ret == 0 && stripe_p->sr_parity_fd >= 0) {
+      /* the parity says there should be more */
+      errno = EIO;
+      return -1;
+    }
+  }
+
+  if (ret > 0) {
+    stripe_p->sr_pos += ret;
+  }
+  return ret;
+}
+
+/*
+ * void stripe_close
+ *
+ * DESCRIPTION:
+ *
+ * Close the stripe files and free the state.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Stripe files that we are closing.
+ */
+void	stripe_close(stripe_read_t *stripe_p)
+{
+  int	file_c;
+
+  if (stripe_p->sr_fds != NULL) {
+    for (file_c = 0; file_c <= stripe_p->sr_data_n; file_c++) {
+      if (stripe_p->sr_fds[file_c] >= 0) {
+	(void)close(stripe_p->sr_fds[file_c]);
+      }
+    }
+    free(stripe_p->sr_fds);
+    stripe_p->sr_fds = NULL;
+  }
+  if (stripe_p->sr_chunk != NULL) {
+    free(stripe_p->sr_chunk);
+    stripe_p->sr_chunk = NULL;
+  }
+}
@@ -0,0 +1,147 @@
+/*
+ * Striped files defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __STRIPE_H__
+#define __STRIPE_H__
+
+/* size of the stream length at the end of the parity file */
+#define STRIPE_TRAILER_SIZE	8
+
+/*
+ * Reading a stream back from its stripe files.  Chunk c of the
+ * stream is in data file c % data_n at offset (c / data_n) * size so
+ * each read is a pread and the files can be read in any order.
+ */
+typedef struct {
+  unsigned long		sr_size;		/* size of each chunk */
+  int			sr_data_n;		/* number of data files */
+  int			*sr_fds;		/* data files then parity */
+  int			sr_missing;		/* data file lost or -1 */
+  int			sr_parity_fd;		/* parity file or -1 */
+  unsigned long long	sr_total;		/* stream size if known */
+  unsigned long long	sr_pos;			/* where we are in it */
+  unsigned long long	sr_ahead;		/* read-ahead requested to */
+  char			*sr_chunk;		/* rebuilt lost chunk */
+  unsigned long long	sr_chunk_row;		/* row that is in it */
+} stripe_read_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void stripe_xor
+ *
+ * DESCRIPTION:
+ *
+ * Exclusive-or a buffer into another.  This works a word at a time
+ * so the compiler can vectorize it.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * dest <-> Buffer that we are xor-ing into.
+ *
+ * src -> Buffer that we are xor-ing with.
+ *
+ * len -> Number of bytes to xor.
+ */
+extern
+void	stripe_xor(char *dest, const char *src, const unsigned long len);
+
+/*
+ * int stripe_open
+ *
+ * DESCRIPTION:
+ *
+ * Open the stripe files for reading the stream back.  If there is a
+ * parity file then one of the data files may be missing and its
+ * chunks are rebuilt from the others.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 with the error printed.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Pointer to the state we are setting up.
+ *
+ * paths -> Paths of the data files in order followed by the parity
+ * file if parity_b.
+ *
+ * path_n -> Number of paths.
+ *
+ * size -> Size of each of the chunks.
+ *
+ * parity_b -> Set to 1 if the last path is the parity file.
+ */
+extern
+int	stripe_open(stripe_read_t *stripe_p, char **paths, const int path_n,
+		    const unsigned long size, const int parity_b);
+
+/*
+ * int stripe_read
+ *
+ * DESCRIPTION:
+ *
+ * Read the next bytes of the stream from the stripe files.  We stop
+ * at the end of the chunk that we are in.
+ *
+ * RETURNS:
+ *
+ * Success - Number of bytes read or 0 at the end of the stream.
+ *
+ * Failure - -1 with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Stripe files that we are reading.
+ *
+ * buf -> Buffer we are reading into.
+ *
+ * buf_len -> Size of the buffer.
+ */
+extern
+int	stripe_read(stripe_read_t *stripe_p, char *buf,
+		    const unsigned long buf_len);
+
+/*
+ * void stripe_close
+ *
+ * DESCRIPTION:
+ *
+ * Close the stripe files and free the state.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * stripe_p -> Stripe files that we are closing.
+ */
+extern
+void	stripe_close(stripe_read_t *stripe_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __STRIPE_H__ */
@@ -0,0 +1,747 @@
+/*
+ * Per-file md5sum routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * The files are split between forked workers which each have their
+ * own buffer.  While a worker hashes one file it has already opened
+ * its next one and asked the kernel to read it in, so the latency of
+ * opening and reading lots of small files overlaps with the hashing.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "argv.h"
+#include "iobuf.h"
+#include "md5.h"
+#include "sum.h"
+
+#define SIG_STRING_LEN	(MD5_SIZE * 2 + 1)	/* hex signature and \0 */
+#define LIST_CHUNK	65536			/* how we grow the list */
+#define READ_AHEAD	(1024 * 1024)		/* prefetch of next file */
+
+/* output is written in chunks that are atomic on a pipe */
+#ifdef PIPE_BUF
+# define OUT_BUF_SIZE	PIPE_BUF
+#else
+# define OUT_BUF_SIZE	512
+#endif
+
+/*
+ * A file to sum and the signature that it should have if we are
+ * checking.
+ */
+typedef struct {
+  char		*si_path;			/* path of the file */
+  char		si_sig[SIG_STRING_LEN];		/* expected or "" */
+} sum_item_t;
+
+/*
+ * What a worker sends back to us.
+ */
+typedef struct {
+  int		sr_failed_n;			/* files that didn't match */
+  int		sr_unread_n;			/* files we couldn't read */
+} sum_result_t;
+
+/* lines of output that have not been written yet */
+static	char	out_buf[OUT_BUF_SIZE];
+static	int	out_len = 0;
+
+/*
+ * Write all of a buffer to a file descriptor.
+ */
+static	void	write_all(const int fd, const char *buf, int len)
+{
+  while (len > 0) {
+    int ret = write(fd, buf, len);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return;
+    }
+    buf += ret;
+    len -= ret;
+  }
+}
+
+/*
+ * Write out the buffered lines.
+ */
+static	void	out_flush(void)
+{
+  (void)fflush(stdout);
+  if (out_len > 0) {
+    write_all(STDOUT_FILENO, out_buf, out_len);
+    out_len = 0;
+  }
+}
+
+/*
+ * Add a line to the output.  We only flush whole lines and no more
+ * than a pipe can take in one write so the lines from the workers
+ * don't get mixed together.
+ */
+static	void	out_line(const char *line, const int len)
+{
+  if (out_len + len > OUT_BUF_SIZE) {
+    out_flush();
+  }
+  if (len > OUT_BUF_SIZE) {
+    write_all(STDOUT_FILENO, line, len);
+  }
+  else {
+    memcpy(out_buf + out_len, line, len);
+    out_len += len;
+  }
+}
+
+/*
+ * Read all of a file descriptor into an allocated buffer that is
+ * terminated with a '\0'.  Returns NULL on error.
+ */
+static	char	*read_fully(const int fd, int *len_p)
+{
+  char	*buf = NULL;
+  int	len = 0, size = 0;
+
+  while (1) {
+    if (len + 1 >= size) {
+      size += LIST_CHUNK;
+      char *new_buf = (char *)realloc(buf, size);
+      if (new_buf == NULL) {
+	free(buf);
+	return NULL;
+      }
+      buf = new_buf;
+    }
+    int ret = read(fd, buf + len, size - len - 1);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      free(buf);
+      return NULL;
+    }
+    if (ret == 0) {
+      break;
+    }
+    len += ret;
+  }
+  buf[len] = '\0';
+  *len_p = len;
+  return buf;
+}
+
+/*
+ * Add an item to a growing array of them.  Returns 0 or -1 if we are
+ * out of memory.
+ */
+static	int	add_item(sum_item_t **items_p, int *item_n_p, int *max_p,
+			 char *path, const char *sig)
+{
+  if (*item_n_p >= *max_p) {
+    int max = (*max_p == 0 ? 1024 : *max_p * 2);
+    sum_item_t *items = (sum_item_t *)realloc(*items_p,
+					      max * sizeof(sum_item_t));
+    if (items == NULL) {
+      return -1;
+    }
+    *items_p = items;
+    *max_p = max;
+  }
+  (*items_p)[*item_n_p].si_path = path;
+  if (sig == NULL) {
+    (*items_p)[*item_n_p].si_sig[0] = '\0';
+  }
+  else {
+    memcpy((*items_p)[*item_n_p].si_sig, sig, SIG_STRING_LEN - 1);
+    (*items_p)[*item_n_p].si_sig[SIG_STRING_LEN - 1] = '\0';
+  }
+  (*item_n_p)++;
+  return 0;
+}
+
+/*
+ * Escape a path like md5sum does if it has a backslash or newline in
+ * it.  Returns 1 if it was escaped else 0.
+ */
+static	int	escape_path(const char *path, char *buf)
+{
+  const char	*path_p;
+  char		*buf_p = buf;
+  int		escaped_b = 0;
+
+  for (path_p = path; *path_p != '\0'; path_p++) {
+    if (*path_p == '\\') {
+      *buf_p++ = '\\';
+      *buf_p++ = '\\';
+      escaped_b = 1;
+    }
+    else if (*path_p == '\n') {
+      *buf_p++ = '\\';
+      *buf_p++ = 'n';
+      escaped_b = 1;
+    }
+    else {
+      *buf_p++ = *path_p;
+    }
+  }
+  *buf_p = '\0';
+  return escaped_b;
+}
+
+/*
+ * Write a --check result line for a path into line escaping the path
+ * like md5sum does.  Returns the length of the line.
+ */
+static	int	check_line(char *line, const char *path, const char *result)
+{
+  int	len;
+
+  /* escape past where the leading \ goes and drop it if not needed */
+  if (escape_path(path, line + 1)) {
+    line[0] = '\\';
+    len = 1 + strlen(line + 1);
+  }
+  else {
+    len = strlen(line + 1);
+    memmove(line, line + 1, len);
+  }
+  len += sprintf(line + len, ": %s\n", result);
+  return len;
+}
+
+/*
+ * Undo the md5sum escaping of a path in place.
+ */
+static	void	unescape_path(char *path)
+{
+  char	*from_p, *to_p = path;
+
+  for (from_p = path; *from_p != '\0'; from_p++) {
+    if (*from_p == '\\' && from_p[1] == '\\') {
+      *to_p++ = '\\';
+      from_p++;
+    }
+    else if (*from_p == '\\' && from_p[1] == 'n') {
+      *to_p++ = '\n';
+      from_p++;
+    }
+    else {
+      *to_p++ = *from_p;
+    }
+  }
+  *to_p = '\0';
+}
+
+/*
+ * static int hash_fd
+ *
+ * DESCRIPTION:
+ *
+ * Run the rest of a file through md5.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 on a read error.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor that we are reading.
+ *
+ * buf -> Buffer to read into.
+ *
+ * buf_size -> Size of the buffer.
+ *
+ * sig_str <- Where the hex signature is written.
+ */
+static	int	hash_fd(const int fd, char *buf, const unsigned long buf_size,
+			char *sig_str)
+{
+  unsigned char	sig[MD5_SIZE];
+  md5_t		md5;
+
+  md5_init(&md5);
+  while (1) {
+    int ret = read(fd, buf, buf_size);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      return -1;
+    }
+    if (ret == 0) {
+      break;
+    }
+    md5_process(&md5, buf, ret);
+  }
+  md5_finish(&md5, sig);
+  md5_sig_to_string(sig, sig_str, SIG_STRING_LEN);
+  return 0;
+}
+
+/*
+ * Open a file and ask the kernel to start reading it in.
+ */
+static	int	open_ahead(const char *path)
+{
+  int	fd = open(path, O_RDONLY, 0);
+
+#if HAVE_POSIX_FADVISE
+  if (fd >= 0) {
+    (void)posix_fadvise(fd, 0, READ_AHEAD, POSIX_FADV_WILLNEED);
+  }
+#endif
+  return fd;
+}
+
+/*
+ * static sum_result_t sum_worker
+ *
+ * DESCRIPTION:
+ *
+ * Sum every stride'th item starting at start and print its md5sum
+ * line or its check result.
+ *
+ * RETURNS:
+ *
+ * Counts of the files that failed.
+ *
+ * ARGUMENTS:
+ *
+ * items -> Array of the items.
+ *
+ * item_n -> Number of items.
+ *
+ * start -> First item that we do.
+ *
+ * stride -> Number of items to skip to our next.
+ *
+ * buf_size -> Size of our read buffer.
+ *
+ * check_b -> Set to 1 to check the signatures instead of printing.
+ */
+static	sum_result_t	sum_worker(sum_item_t *items, const int item_n,
+				   const int start, const int stride,
+				   const unsigned long buf_size,
+				   const int check_b)
+{
+  sum_result_t	result;
+  char		sig_str[SIG_STRING_LEN], *line = NULL;
+  int		line_size = 0, item_c, next_fd = -1, err;
+
+  result.sr_failed_n = 0;
+  result.sr_unread_n = 0;
+
+  char *buf = (char *)iobuf_alloc(buf_size);
+  if (buf == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate %ld bytes for buffer\n",
+		  argv_program, buf_size);
+    result.sr_unread_n = item_n;
+    return result;
+  }
+
+  for (item_c = start; item_c < item_n; item_c += stride) {
+    sum_item_t *item_p = items + item_c;
+
+    /* use the descriptor we opened ahead or open it now */
+    int fd = next_fd;
+    err = 0;
+    if (fd < 0) {
+      fd = open(item_p->si_path, O_RDONLY, 0);
+      if (fd < 0) {
+	/* save it before opening ahead can change it */
+	err = errno;
+      }
+    }
+    next_fd = -1;
+    if (item_c + stride < item_n) {
+      next_fd = open_ahead(items[item_c + stride].si_path);
+    }
+
+    int path_len = strlen(item_p->si_path);
+    if (line_size < path_len * 2 + SIG_STRING_LEN + 32) {
+      line_size = path_len * 2 + SIG_STRING_LEN + 32;
+      free(line);
+      line = (char *)malloc(line_size);
+      if (line == NULL) {
+	(void)fprintf(stderr, "%s: out of memory\n", argv_program);
+	exit(1);
+      }
+    }
+
+#if HAVE_POSIX_FADVISE
+    if (fd >= 0) {
+      (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    if (fd >= 0 && hash_fd(fd, buf, buf_size, sig_str) != 0) {
+      err = errno;
+    }
+    if (fd < 0 || err != 0) {
+      (void)fprintf(stderr, "%s: %s: %s\n",
+		    argv_program, item_p->si_path, strerror(err));
+      if (fd >= 0) {
+	(void)close(fd);
+      }
+      result.sr_unread_n++;
+      if (check_b) {
+	out_line(line, check_line(line, item_p->si_path,
+				  "FAILED open or read"));
+      }
+      continue;
+    }
+    (void)close(fd);
+
+    int len;
+    if (check_b) {
+      if (strcasecmp(sig_str, item_p->si_sig) == 0) {
+	len = check_line(line, item_p->si_path, "OK");
+      }
+      else {
+	len = check_line(line, item_p->si_path, "FAILED");
+	result.sr_failed_n++;
+      }
+    }
+    else {
+      /*
+       * md5sum escapes the line if the path has a \ or newline.  We
+       * escape it into the line past where the signature goes.
+       */
+      char *escaped = line + SIG_STRING_LEN + 8;
+      int escaped_b = escape_path(item_p->si_path, escaped);
+      len = sprintf(line, "%s%s  ", (escaped_b ? "\\" : ""), sig_str);
+      memmove(line + len, escaped, strlen(escaped) + 1);
+      len += strlen(line + len);
+      line[len++] = '\n';
+    }
+    out_line(line, len);
+  }
+
+  out_flush();
+  if (next_fd >= 0) {
+    (void)close(next_fd);
+  }
+  free(line);
+  iobuf_free(buf, buf_size);
+  return result;
+}
+
+/*
+ * static int run_workers
+ *
+ * DESCRIPTION:
+ *
+ * Split the items between job_n workers and total up their results.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not start the workers.
+ *
+ * ARGUMENTS:
+ *
+ * items -> Array of the items.
+ *
+ * item_n -> Number of items.
+ *
+ * job_n -> Number of worker processes or 0 for one per CPU.
+ *
+ * buf_size -> Size of each worker's read buffer.
+ *
+ * check_b -> Set to 1 to check the signatures instead of printing.
+ *
+ * result_p <- Totals of the worker's results.
+ */
+static	int	run_workers(sum_item_t *items, const int item_n, int job_n,
+			    const unsigned long buf_size, const int check_b,
+			    sum_result_t *result_p)
+{
+  sum_result_t	result;
+  int		pipe_fds[2], job_c;
+
+  result_p->sr_failed_n = 0;
+  result_p->sr_unread_n = 0;
+
+  if (job_n <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    job_n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  }
+  if (job_n > item_n) {
+    job_n = item_n;
+  }
+  if (job_n <= 1) {
+    if (item_n > 0) {
+      *result_p = sum_worker(items, item_n, 0, 1, buf_size, check_b);
+    }
+    return 0;
+  }
+
+  if (pipe(pipe_fds) != 0) {
+    (void)fprintf(stderr, "%s: could not create pipe: %s\n",
+		  argv_program, strerror(errno));
+    return -1;
+  }
+  (void)fflush(stdout);
+  (void)fflush(stderr);
+
+  int started_n = 0;
+  for (job_c = 0; job_c < job_n; job_c++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      (void)fprintf(stderr, "%s: could not fork worker: %s\n",
+		    argv_program, strerror(errno));
+      break;
+    }
+    if (pid == 0) {
+      (void)close(pipe_fds[0]);
+      result = sum_worker(items, item_n, job_c, job_n, buf_size, check_b);
+      write_all(pipe_fds[1], (char *)&result, sizeof(result));
+      _exit(0);
+    }
+    started_n++;
+  }
+  (void)close(pipe_fds[1]);
+
+  /* the results are small enough that each is written atomically */
+  int read_n = 0;
+  while (read(pipe_fds[0], &result, sizeof(result)) == sizeof(result)) {
+    result_p->sr_failed_n += result.sr_failed_n;
+    result_p->sr_unread_n += result.sr_unread_n;
+    read_n++;
+  }
+  (void)close(pipe_fds[0]);
+  while (wait(NULL) > 0) {
+  }
+
+  if (started_n < job_n || read_n < started_n) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * int sum_files
+ *
+ * DESCRIPTION:
+ *
+ * Print an md5sum compatible line for each of a list of files.  The
+ * files are split between a number of worker processes so the lines
+ * come out in no particular order like xargs -P.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if any of the files could not be read.
+ *
+ * ARGUMENTS:
+ *
+ * paths -> Array of paths to sum or NULL to read a list of paths
+ * separated by '\0' characters from stdin.
+ *
+ * path_n -> Number of paths in the array.
+ *
+ * job_n -> Number of worker processes or 0 for one per CPU.
+ *
+ * buf_size -> Size of each worker's read buffer.
+ */
+int	sum_files(char **paths, const int path_n, const int job_n,
+		  const unsigned long buf_size)
+{
+  sum_item_t	*items = NULL;
+  sum_result_t	result;
+  char		*list = NULL;
+  int		item_n = 0, item_max = 0, path_c, ret;
+
+  if (paths != NULL) {
+    for (path_c = 0; path_c < path_n; path_c++) {
+      if (add_item(&items, &item_n, &item_max, paths[path_c], NULL) != 0) {
+	(void)fprintf(stderr, "%s: out of memory\n", argv_program);
+	return -1;
+      }
+    }
+  }
+  else {
+    int list_len;
+    list = read_fully(STDIN_FILENO, &list_len);
+    if (list == NULL) {
+      (void)fprintf(stderr, "%s: could not read file list: %s\n",
+		    argv_program, strerror(errno));
+      return -1;
+    }
+    char *list_p = list, *bounds_p = list + list_len;
+    while (list_p < bounds_p) {
+      int len = strlen(list_p);
+      if (len > 0
+	  && add_item(&items, &item_n, &item_max, list_p, NULL) != 0) {
+	(void)fprintf(stderr, "%s: out of memory\n", argv_program);
+	free(list);
+	return -1;
+      }
+      list_p += len + 1;
+    }
+  }
+
+  ret = run_workers(items, item_n, job_n, buf_size, 0, &result);
+  if (result.sr_unread_n > 0) {
+    ret = -1;
+  }
+
+  free(items);
+  if (list != NULL) {
+    free(list);
+  }
+  return ret;
+}
+
+/*
+ * int sum_check
+ *
+ * DESCRIPTION:
+ *
+ * Read md5sum lines from a file and verify that the files they list
+ * have those signatures, printing OK or FAILED for each like
+ * md5sum --check.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if any file did not match or could not be read or the
+ * list could not be read.
+ *
+ * ARGUMENTS:
+ *
+ * list_path -> File of md5sum lines to check.
+ *
+ * job_n -> Number of worker processes or 0 for one per CPU.
+ *
+ * buf_size -> Size of each worker's read buffer.
+ */
+int	sum_check(const char *list_path, const int job_n,
+		  const unsigned long buf_size)
+{
+  sum_item_t	*items = NULL;
+  sum_result_t	result;
+  char		*list, *line_p, *next_p;
+  int		item_n = 0, item_max = 0, list_len, bad_n = 0, ret;
+
+  int fd = open(list_path, O_RDONLY, 0);
+  if (fd < 0) {
+    (void)fprintf(stderr, "%s: cannot open(%s): %s\n",
+		  argv_program, list_path, strerror(errno));
+    return -1;
+  }
+  list = read_fully(fd, &list_len);
+  (void)close(fd);
+  if (list == NULL) {
+    (void)fprintf(stderr, "%s: could not read %s: %s\n",
+		  argv_program, list_path, strerror(errno));
+    return -1;
+  }
+
+  /* each line is the hex signature, a space, a space or '*', and path */
+  for (line_p = list; *line_p != '\0'; line_p = next_p) {
+    next_p = strchr(line_p, '\n');
+    if (next_p == NULL) {
+      next_p = line_p + strlen(line_p);
+    }
+    else {
+      *next_p++ = '\0';
+    }
+    if (*line_p == '\0') {
+      continue;
+    }
+
+    int escaped_b = 0;
+    if (*line_p == '\\') {
+      escaped_b = 1;
+      line_p++;
+    }
+    if ((int)strspn(line_p, "0123456789abcdefABCDEF") != MD5_SIZE * 2
+	|| line_p[MD5_SIZE * 2] != ' '
+	|| (line_p[MD5_SIZE * 2 + 1] != ' ' && line_p[MD5_SIZE * 2 + 1] != '*')
+	|| line_p[MD5_SIZE * 2 + 2] == '\0') {
+      bad_n++;
+      continue;
+    }
+    char *path = line_p + MD5_SIZE * 2 + 2;
+    if (escaped_b) {
+      unescape_path(path);
+    }
+    if (add_item(&items, &item_n, &item_max, path, line_p) != 0) {
+      (void)fprintf(stderr, "%s: out of memory\n", argv_program);
+      free(list);
+      return -1;
+    }
+  }
+
+  ret = run_workers(items, item_n, job_n, buf_size, 1, &result);
+
+  if (bad_n > 0) {
+    (void)fprintf(stderr, "%s: WARNING: %d line%s improperly formatted\n",
+		  argv_program, bad_n, (bad_n == 1 ? " is" : "s are"));
+  }
+  if (result.sr_unread_n > 0) {
+    (void)fprintf(stderr, "%s: WARNING: %d listed file%s could not be read\n",
+		  argv_program, result.sr_unread_n,
+		  (result.sr_unread_n == 1 ? "" : "s"));
+    ret = -1;
+  }
+  if (result.sr_failed_n > 0) {
+    (void)fprintf(stderr,
+		  "%s: WARNING: %d computed checksum%s did NOT match\n",
+		  argv_program, result.sr_failed_n,
+		  (result.sr_failed_n == 1 ? "" : "s"));
+    ret = -1;
+  }
+  if (item_n == 0) {
+    (void)fprintf(stderr, "%s: %s: no properly formatted md5 lines found\n",
+		  argv_program, list_path);
+    ret = -1;
+  }
+
+  free(items);
+  free(list);
+  return ret;
+}
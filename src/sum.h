@@ -0,0 +1,85 @@
+/*
+ * Per-file md5sum defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __SUM_H__
+#define __SUM_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int sum_files
+ *
+ * DESCRIPTION:
+ *
+ * Print an md5sum compatible line for each of a list of files.  The
+ * files are split between a number of worker processes so the lines
+ * come out in no particular order like xargs -P.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if any of the files could not be read.
+ *
+ * ARGUMENTS:
+ *
+ * paths -> Array of paths to sum or NULL to read a list of paths
+ * separated by '\0' characters from stdin.
+ *
+ * path_n -> Number of paths in the array.
+ *
+ * job_n -> Number of worker processes or 0 for one per CPU.
+ *
+ * buf_size -> Size of each worker's read buffer.
+ */
+extern
+int	sum_files(char **paths, const int path_n, const int job_n,
+		  const unsigned long buf_size);
+
+/*
+ * int sum_check
+ *
+ * DESCRIPTION:
+ *
+ * Read md5sum lines from a file and verify that the files they list
+ * have those signatures, printing OK or FAILED for each like
+ * md5sum --check.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if any file did not match or could not be read or the
+ * list could not be read.
+ *
+ * ARGUMENTS:
+ *
+ * list_path -> File of md5sum lines to check.
+ *
+ * job_n -> Number of worker processes or 0 for one per CPU.
+ *
+ * buf_size -> Size of each worker's read buffer.
+ */
+extern
+int	sum_check(const char *list_path, const int job_n,
+		  const unsigned long buf_size);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __SUM_H__ */
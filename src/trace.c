@@ -0,0 +1,291 @@
+/*
+ * Binary trace ring routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * Formatting a line to stderr for every read and write slows null
+ * down far more than the i/o it is describing.  Instead we stamp a
+ * small binary event into a ring and only turn them into text when
+ * they are dumped.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include "argv.h"
+#include "hist.h"
+#include "trace.h"
+
+#define RING_MASK	(TRACE_RING_EVENTS - 1)
+#define MAX_EVENT_SIZE	0xFFFFFFFFUL	/* largest te_size */
+
+/* format of each type of event which is passed the size */
+static	const char	*event_formats[TRACE_TYPE_N] = {
+  "unknown event",
+  "read %lu bytes",
+  "replayed %lu bytes",
+  "wrote %lu bytes",
+  "wrote starting pagination",
+  " wrote %lu paged chars",
+  " wrote mid pagination",
+  "wrote ending pagination",
+  " trimmed %lu bytes of starting pagination",
+  " trimmed 1 byte of mid pagination",
+  " trimmed %lu bytes of end pagination",
+  " trimmed %lu paged end chars",
+  "lost %lu events that overflowed the trace ring",
+};
+
+/* the ring and where we are in it */
+static	trace_event_t		*ring = NULL;		/* ring of events */
+static	unsigned long long	record_c = 0;		/* events recorded */
+static	unsigned long long	dump_c = 0;		/* events dumped */
+static	unsigned long long	start_time = 0;		/* ns when we started */
+static	const char		*trace_path = NULL;	/* binary trace file */
+static	FILE			*trace_file = NULL;	/* open trace file */
+
+/*
+ * Write one event as a line of text.
+ */
+static	void	decode_event(FILE *outfile, const unsigned long long start,
+			     const trace_event_t *event_p)
+{
+  unsigned long long	rel = 0;
+  unsigned int		type = event_p->te_type;
+
+  if (event_p->te_time > start) {
+    rel = event_p->te_time - start;
+  }
+  if (type >= TRACE_TYPE_N) {
+    type = 0;
+  }
+  (void)fprintf(outfile, "%6llu.%06llu ", rel / 1000000000ULL,
+		(rel % 1000000000ULL) / 1000ULL);
+  (void)fprintf(outfile, event_formats[type], (unsigned long)event_p->te_size);
+  (void)fputc('\n', outfile);
+}
+
+/*
+ * Write one event to the trace file or decode it to stderr.  Returns
+ * 0 on success or -1 on a file error.
+ */
+static	int	dump_event(const trace_event_t *event_p)
+{
+  if (trace_path == NULL) {
+    decode_event(stderr, start_time, event_p);
+    return 0;
+  }
+
+  if (trace_file == NULL) {
+    trace_header_t	header;
+
+    trace_file = fopen(trace_path, "w");
+    if (trace_file == NULL) {
+      return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.th_magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+    header.th_start = start_time;
+    if (fwrite(&header, sizeof(header), 1, trace_file) != 1) {
+      return -1;
+    }
+  }
+  if (fwrite(event_p, sizeof(*event_p), 1, trace_file) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * int trace_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the trace ring and start recording.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the ring.
+ *
+ * ARGUMENTS:
+ *
+ * path -> File that trace_dump writes the binary events to or NULL
+ * to decode them to stderr.
+ */
+int	trace_init(const char *path)
+{
+  ring = (trace_event_t *)calloc(TRACE_RING_EVENTS, sizeof(trace_event_t));
+  if (ring == NULL) {
+    return -1;
+  }
+  trace_path = path;
+  record_c = 0;
+  dump_c = 0;
+  start_time = hist_now();
+  return 0;
+}
+
+/*
+ * void trace_record
+ *
+ * DESCRIPTION:
+ *
+ * Record an event into the ring.  If the ring fills up before it is
+ * dumped then the oldest events are overwritten.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * type -> TRACE_ type of the event.
+ *
+ * size -> Number of bytes involved or 0.
+ */
+void	trace_record(const int type, const unsigned long size)
+{
+  trace_event_t	*event_p;
+
+  if (ring == NULL) {
+    return;
+  }
+  event_p = ring + (record_c & RING_MASK);
+  event_p->te_time = hist_now();
+  event_p->te_type = type;
+  if (size > MAX_EVENT_SIZE) {
+    event_p->te_size = MAX_EVENT_SIZE;
+  }
+  else {
+    event_p->te_size = size;
+  }
+  record_c++;
+}
+
+/*
+ * int trace_dump
+ *
+ * DESCRIPTION:
+ *
+ * Write out the events that have been recorded since the last dump
+ * either to the trace file or decoded to stderr.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the trace file.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+int	trace_dump(void)
+{
+  unsigned long long	event_c;
+  int			ret = 0;
+
+  if (ring == NULL) {
+    return 0;
+  }
+
+  /* note the events that were overwritten before we got to them */
+  if (record_c - dump_c > TRACE_RING_EVENTS) {
+    trace_event_t	lost;
+    unsigned long long	lost_c = record_c - TRACE_RING_EVENTS - dump_c;
+
+    dump_c = record_c - TRACE_RING_EVENTS;
+    lost.te_time = ring[dump_c & RING_MASK].te_time;
+    lost.te_type = TRACE_LOST;
+    lost.te_size = (lost_c > MAX_EVENT_SIZE ? MAX_EVENT_SIZE : lost_c);
+    if (dump_event(&lost) != 0) {
+      ret = -1;
+    }
+  }
+
+  for (event_c = dump_c; event_c < record_c && ret == 0; event_c++) {
+    if (dump_event(ring + (event_c & RING_MASK)) != 0) {
+      ret = -1;
+    }
+  }
+  dump_c = record_c;
+
+  if (trace_file != NULL && fflush(trace_file) != 0) {
+    ret = -1;
+  }
+  return ret;
+}
+
+/*
+ * int trace_decode
+ *
+ * DESCRIPTION:
+ *
+ * Decode a binary trace file into lines of text.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the file could not be read or is not a trace file
+ * with the error printed.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Trace file that we are decoding.
+ *
+ * outfile -> Where we write the text.
+ */
+int	trace_decode(const char *path, FILE *outfile)
+{
+  trace_header_t	header;
+  trace_event_t		event;
+  FILE			*infile;
+
+  infile = fopen(path, "r");
+  if (infile == NULL) {
+    (void)fprintf(stderr, "%s: cannot fopen(%s): %s\n",
+		  argv_program, path, strerror(errno));
+    return -1;
+  }
+  if (fread(&header, sizeof(header), 1, infile) != 1
+      || memcmp(header.th_magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+    (void)fprintf(stderr, "%s: %s is not a null trace file\n",
+		  argv_program, path);
+    (void)fclose(infile);
+    return -1;
+  }
+
+  while (fread(&event, sizeof(event), 1, infile) == 1) {
+    decode_event(outfile, header.th_start, &event);
+  }
+
+  (void)fclose(infile);
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Binary trace ring defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>			/* for FILE * below */
+
+/* number of events in the ring, must be a power of 2 */
+#define TRACE_RING_EVENTS	65536
+
+/* magic string at the start of trace files */
+#define TRACE_MAGIC		"NULLTRC1"
+#define TRACE_MAGIC_LEN		8
+
+/* the events that we record */
+#define TRACE_READ		1	/* read from the input */
+#define TRACE_REPLAY		2	/* read back from the -a store */
+#define TRACE_WRITE		3	/* wrote a block to the outputs */
+#define TRACE_PAGE_START	4	/* wrote starting pagination */
+#define TRACE_PAGE_WRITE	5	/* wrote paged chars */
+#define TRACE_PAGE_MID		6	/* wrote mid pagination */
+#define TRACE_PAGE_END		7	/* wrote ending pagination */
+#define TRACE_TRIM_START	8	/* trimmed starting pagination */
+#define TRACE_TRIM_MID		9	/* trimmed mid pagination */
+#define TRACE_TRIM_END		10	/* trimmed end pagination */
+#define TRACE_TRIM_AFTER	11	/* trimmed chars after the end */
+#define TRACE_LOST		12	/* events that overflowed the ring */
+#define TRACE_TYPE_N		13
+
+/*
+ * Header at the start of a trace file which is followed by the
+ * events.  Both are in the byte order of the machine that wrote them.
+ */
+typedef struct {
+  char			th_magic[TRACE_MAGIC_LEN];	/* TRACE_MAGIC */
+  unsigned long long	th_start;			/* ns start time */
+} trace_header_t;
+
+/*
+ * One event in the ring.
+ */
+typedef struct {
+  unsigned long long	te_time;		/* ns time-stamp */
+  unsigned int		te_type;		/* TRACE_ type */
+  unsigned int		te_size;		/* bytes if any */
+} trace_event_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int trace_init
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the trace ring and start recording.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the ring.
+ *
+ * ARGUMENTS:
+ *
+ * path -> File that trace_dump writes the binary events to or NULL
+ * to decode them to stderr.
+ */
+extern
+int	trace_init(const char *path);
+
+/*
+ * void trace_record
+ *
+ * DESCRIPTION:
+ *
+ * Record an event into the ring.  If the ring fills up before it is
+ * dumped then the oldest events are overwritten.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * type -> TRACE_ type of the event.
+ *
+ * size -> Number of bytes involved or 0.
+ */
+extern
+void	trace_record(const int type, const unsigned long size);
+
+/*
+ * int trace_dump
+ *
+ * DESCRIPTION:
+ *
+ * Write out the events that have been recorded since the last dump
+ * either to the trace file or decoded to stderr.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not write to the trace file.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+extern
+int	trace_dump(void);
+
+/*
+ * int trace_decode
+ *
+ * DESCRIPTION:
+ *
+ * Decode a binary trace file into lines of text.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if the file could not be read or is not a trace file
+ * with the error printed.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Trace file that we are decoding.
+ *
+ * outfile -> Where we write the text.
+ */
+extern
+int	trace_decode(const char *path, FILE *outfile);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __TRACE_H__ */
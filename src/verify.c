@@ -0,0 +1,401 @@
+/*
+ * Stream verification routines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+/*
+ * An md5 at the end only tells us that a stream was bad.  Here we
+ * compare it as it goes by so we can say where.  The buffers are
+ * compared whole with memcmp, which the C library vectorizes, and we
+ * only look closer at the ones that differ.  What we expect either
+ * comes from a generator or from a reference file which we map so
+ * the input is compared against the page cache without a copy.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "conf.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+
+#include "argv.h"
+#include "gen.h"
+#include "verify.h"
+
+#define SCAN_SIZE	64		/* bytes we memcmp while scanning */
+
+/*
+ * Note the end of a differing range and print it if it is one of the
+ * first.
+ */
+static	void	end_range(verify_t *verify_p, const unsigned long long end)
+{
+  if (verify_p->ve_range_n <= VERIFY_REPORT_N) {
+    (void)fprintf(stderr, "%s: stream differs at offset %llu for %llu bytes\n",
+		  argv_program, verify_p->ve_range_start,
+		  end - verify_p->ve_range_start);
+  }
+  if (verify_p->ve_range_n == VERIFY_REPORT_N) {
+    (void)fprintf(stderr, "%s: not reporting any more differences\n",
+		  argv_program);
+  }
+  verify_p->ve_in_range_b = 0;
+}
+
+/*
+ * Note a differing byte at an offset in the stream.
+ */
+static	void	diff_byte(verify_t *verify_p, const unsigned long long offset)
+{
+  unsigned long long	block = offset / VERIFY_BLOCK_SIZE + 1;
+  
+  verify_p->ve_diff_bytes++;
+  if (! verify_p->ve_in_range_b) {
+    verify_p->ve_in_range_b = 1;
+    verify_p->ve_range_start = offset;
+    if (verify_p->ve_range_n == 0) {
+      verify_p->ve_first_diff = offset;
+    }
+    verify_p->ve_range_n++;
+  }
+  if (block != verify_p->ve_last_bad) {
+    verify_p->ve_bad_block_n++;
+    verify_p->ve_last_bad = block;
+  }
+}
+
+/*
+ * Compare two buffers that we know differ somewhere and note the
+ * differing ranges.
+ */
+static	void	scan_diffs(verify_t *verify_p, const char *buf,
+			   const char *expect, const unsigned long len)
+{
+  unsigned long	pos, chunk, byte_c;
+  
+  for (pos = 0; pos < len; pos += chunk) {
+    chunk = SCAN_SIZE;
+    if (chunk > len - pos) {
+      chunk = len - pos;
+    }
+    if (memcmp(buf + pos, expect + pos, chunk) == 0) {
+      if (verify_p->ve_in_range_b) {
+	end_range(verify_p, verify_p->ve_offset + pos);
+      }
+      continue;
+    }
+    for (byte_c = pos; byte_c < pos + chunk; byte_c++) {
+      if (buf[byte_c] != expect[byte_c]) {
+	diff_byte(verify_p, verify_p->ve_offset + byte_c);
+      }
+      else if (verify_p->ve_in_range_b) {
+	end_range(verify_p, verify_p->ve_offset + byte_c);
+      }
+    }
+  }
+}
+
+/*
+ * Get the next bytes that we expect into a pointer.  Returns how many
+ * we got which is less than len if the reference file ended.
+ */
+static	unsigned long	expect_bytes(verify_t *verify_p, const unsigned long len,
+				     const char **expect_pp)
+{
+  unsigned long	got = 0;
+  
+  if (verify_p->ve_gen_p != NULL) {
+    gen_fill(verify_p->ve_gen_p, verify_p->ve_buf, len);
+    *expect_pp = verify_p->ve_buf;
+    return len;
+  }
+  
+  if (verify_p->ve_map != NULL) {
+    if (verify_p->ve_offset < verify_p->ve_ref_size) {
+      got = verify_p->ve_ref_size - verify_p->ve_offset;
+      if (got > len) {
+	got = len;
+      }
+    }
+    *expect_pp = verify_p->ve_map + verify_p->ve_offset;
+    return got;
+  }
+  
+  while (got < len) {
+    ssize_t ret = read(verify_p->ve_fd, verify_p->ve_buf + got, len - got);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      /* a read error is treated like the end of the reference */
+      break;
+    }
+    got += ret;
+  }
+  *expect_pp = verify_p->ve_buf;
+  return got;
+}
+
+/*
+ * int verify_init
+ *
+ * DESCRIPTION:
+ *
+ * Setup verification of a stream against a generator.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the buffer.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state that we are setting up.
+ *
+ * gen_p -> Generator of the bytes that we expect.
+ *
+ * buf_size -> Largest buffer that will be passed to verify_process.
+ */
+int	verify_init(verify_t *verify_p, gen_t *gen_p,
+		    const unsigned long buf_size)
+{
+  memset(verify_p, 0, sizeof(*verify_p));
+  verify_p->ve_buf = (char *)malloc(buf_size);
+  if (verify_p->ve_buf == NULL) {
+    return -1;
+  }
+  verify_p->ve_buf_size = buf_size;
+  verify_p->ve_gen_p = gen_p;
+  verify_p->ve_fd = -1;
+  verify_p->ve_label = "verify";
+  return 0;
+}
+
+/*
+ * int verify_open
+ *
+ * DESCRIPTION:
+ *
+ * Setup comparing a stream against a reference file.  A regular file
+ * is mapped and anything else is read alongside the stream.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not open the file or allocate the buffer
+ * with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state that we are setting up.
+ *
+ * path -> Reference file that the stream should match.
+ *
+ * buf_size -> Largest buffer that will be passed to verify_process.
+ */
+int	verify_open(verify_t *verify_p, const char *path,
+		    const unsigned long buf_size)
+{
+  struct stat	statbuf;
+  
+  memset(verify_p, 0, sizeof(*verify_p));
+  verify_p->ve_label = "compare";
+  verify_p->ve_fd = open(path, O_RDONLY, 0);
+  if (verify_p->ve_fd < 0) {
+    return -1;
+  }
+  
+#if HAVE_MMAP
+  if (fstat(verify_p->ve_fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode)
+      && statbuf.st_size > 0) {
+    void *map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED,
+		     verify_p->ve_fd, 0);
+    if (map != MAP_FAILED) {
+      verify_p->ve_map = (const char *)map;
+      verify_p->ve_ref_size = statbuf.st_size;
+# if HAVE_MADVISE
+      (void)madvise(map, statbuf.st_size, MADV_SEQUENTIAL);
+# endif
+      return 0;
+    }
+  }
+#endif
+  
+#if HAVE_POSIX_FADVISE
+  (void)posix_fadvise(verify_p->ve_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  verify_p->ve_buf = (char *)malloc(buf_size);
+  if (verify_p->ve_buf == NULL) {
+    (void)close(verify_p->ve_fd);
+    return -1;
+  }
+  verify_p->ve_buf_size = buf_size;
+  return 0;
+}
+
+/*
+ * void verify_process
+ *
+ * DESCRIPTION:
+ *
+ * Compare the next bytes of the stream with what we expect, printing
+ * the first of the differing ranges as they end.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state.
+ *
+ * buf -> Next bytes of the stream.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+void	verify_process(verify_t *verify_p, const char *buf,
+		       const unsigned long buf_len)
+{
+  unsigned long	done = 0, len;
+  const char	*expect;
+  
+  while (done < buf_len) {
+    if (verify_p->ve_ref_end_b) {
+      /* the input is longer than the reference */
+      verify_p->ve_extra += buf_len - done;
+      break;
+    }
+    len = buf_len - done;
+    if (verify_p->ve_map == NULL && len > verify_p->ve_buf_size) {
+      len = verify_p->ve_buf_size;
+    }
+    len = expect_bytes(verify_p, len, &expect);
+    if (len == 0) {
+      verify_p->ve_ref_end_b = 1;
+      continue;
+    }
+    
+    if (memcmp(buf + done, expect, len) == 0) {
+      if (verify_p->ve_in_range_b) {
+	end_range(verify_p, verify_p->ve_offset);
+      }
+    }
+    else {
+      scan_diffs(verify_p, buf + done, expect, len);
+    }
+    verify_p->ve_offset += len;
+    done += len;
+  }
+}
+
+/*
+ * int verify_finish
+ *
+ * DESCRIPTION:
+ *
+ * Finish the verification, print a summary if there were differences
+ * or if verbose, and free the state.  With a reference file it is
+ * also a difference if the input was longer or shorter.
+ *
+ * RETURNS:
+ *
+ * Success - 0 if the stream matched.
+ *
+ * Failure - -1 if there were differences.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state.
+ *
+ * verbose_b -> Set to 1 to print the summary even if it matched.
+ */
+int	verify_finish(verify_t *verify_p, const int verbose_b)
+{
+  int	failed_b = 0;
+  
+  if (verify_p->ve_in_range_b) {
+    end_range(verify_p, verify_p->ve_offset);
+  }
+  
+  if (verify_p->ve_range_n > 0) {
+    (void)fprintf(stderr,
+		  "%s: %s FAILED: %llu of %llu bytes differ in %llu ranges "
+		  "and %llu %d byte blocks, first at offset %llu\n",
+		  argv_program, verify_p->ve_label, verify_p->ve_diff_bytes,
+		  verify_p->ve_offset, verify_p->ve_range_n,
+		  verify_p->ve_bad_block_n, VERIFY_BLOCK_SIZE,
+		  verify_p->ve_first_diff);
+    failed_b = 1;
+  }
+  
+  /* with a reference file the lengths have to match as well */
+  if (verify_p->ve_extra > 0) {
+    (void)fprintf(stderr,
+		  "%s: %s FAILED: input has %llu bytes past the reference "
+		  "which ends at offset %llu\n",
+		  argv_program, verify_p->ve_label, verify_p->ve_extra,
+		  verify_p->ve_offset);
+    failed_b = 1;
+  }
+  else if (verify_p->ve_gen_p == NULL && (! verify_p->ve_ref_end_b)) {
+    const char	*expect;
+    if (expect_bytes(verify_p, 1, &expect) > 0) {
+      (void)fprintf(stderr,
+		    "%s: %s FAILED: input ended at offset %llu before the "
+		    "reference\n",
+		    argv_program, verify_p->ve_label, verify_p->ve_offset);
+      failed_b = 1;
+    }
+  }
+  
+  if ((! failed_b) && verbose_b) {
+    (void)fprintf(stderr, "%s: %s of %llu bytes OK\n",
+		  argv_program, verify_p->ve_label, verify_p->ve_offset);
+  }
+  
+#if HAVE_MMAP
+  if (verify_p->ve_map != NULL) {
+    (void)munmap((void *)verify_p->ve_map, verify_p->ve_ref_size);
+    verify_p->ve_map = NULL;
+  }
+#endif
+  if (verify_p->ve_fd >= 0) {
+    (void)close(verify_p->ve_fd);
+    verify_p->ve_fd = -1;
+  }
+  if (verify_p->ve_buf != NULL) {
+    free(verify_p->ve_buf);
+    verify_p->ve_buf = NULL;
+  }
+  return (failed_b ? -1 : 0);
+}
@@ -0,0 +1,160 @@
+/*
+ * Stream verification defines
+ *
+ * Copyright 2026 by Gray Watson
+ *
+ * This file is part of the null utility.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __VERIFY_H__
+#define __VERIFY_H__
+
+#include "gen.h"
+
+/* bad blocks are counted in units of this many bytes */
+#define VERIFY_BLOCK_SIZE	4096
+
+/* number of differing ranges that we print before going quiet */
+#define VERIFY_REPORT_N		10
+
+/*
+ * Verification state.  The input is compared against what the
+ * generator makes or what is in the reference file at the same
+ * offsets.
+ */
+typedef struct {
+  const char		*ve_label;	/* what we call it in messages */
+  gen_t			*ve_gen_p;	/* makes the expected bytes */
+  int			ve_fd;		/* reference file or -1 */
+  const char		*ve_map;	/* mapped reference or NULL */
+  unsigned long long	ve_ref_size;	/* size of the mapped file */
+  int			ve_ref_end_b;	/* reached end of the reference */
+  unsigned long long	ve_extra;	/* input bytes past its end */
+  char			*ve_buf;	/* expected bytes */
+  unsigned long		ve_buf_size;	/* size of the buffer */
+  unsigned long long	ve_offset;	/* bytes compared so far */
+  unsigned long long	ve_diff_bytes;	/* bytes that differed */
+  unsigned long long	ve_range_n;	/* differing ranges */
+  unsigned long long	ve_first_diff;	/* offset of the first */
+  unsigned long long	ve_range_start;	/* start of the current range */
+  int			ve_in_range_b;	/* in a differing range */
+  unsigned long long	ve_bad_block_n;	/* blocks with differences */
+  unsigned long long	ve_last_bad;	/* last bad block plus 1 */
+} verify_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int verify_init
+ *
+ * DESCRIPTION:
+ *
+ * Setup verification of a stream against a generator.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not allocate the buffer.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state that we are setting up.
+ *
+ * gen_p -> Generator of the bytes that we expect.
+ *
+ * buf_size -> Largest buffer that will be passed to verify_process.
+ */
+extern
+int	verify_init(verify_t *verify_p, gen_t *gen_p,
+		    const unsigned long buf_size);
+
+/*
+ * int verify_open
+ *
+ * DESCRIPTION:
+ *
+ * Setup comparing a stream against a reference file.  A regular file
+ * is mapped and anything else is read alongside the stream.
+ *
+ * RETURNS:
+ *
+ * Success - 0
+ *
+ * Failure - -1 if we could not open the file or allocate the buffer
+ * with errno set.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state that we are setting up.
+ *
+ * path -> Reference file that the stream should match.
+ *
+ * buf_size -> Largest buffer that will be passed to verify_process.
+ */
+extern
+int	verify_open(verify_t *verify_p, const char *path,
+		    const unsigned long buf_size);
+
+/*
+ * void verify_process
+ *
+ * DESCRIPTION:
+ *
+ * Compare the next bytes of the stream with what we expect, printing
+ * the first of the differing ranges as they end.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state.
+ *
+ * buf -> Next bytes of the stream.
+ *
+ * buf_len -> Number of bytes in the buffer.
+ */
+extern
+void	verify_process(verify_t *verify_p, const char *buf,
+		       const unsigned long buf_len);
+
+/*
+ * int verify_finish
+ *
+ * DESCRIPTION:
+ *
+ * Finish the verification, print a summary if there were differences
+ * or if verbose, and free the state.  With a reference file it is
+ * also a difference if the input was longer or shorter.
+ *
+ * RETURNS:
+ *
+ * Success - 0 if the stream matched.
+ *
+ * Failure - -1 if there were differences.
+ *
+ * ARGUMENTS:
+ *
+ * verify_p -> Verification state.
+ *
+ * verbose_b -> Set to 1 to print the summary even if it matched.
+ */
+extern
+int	verify_finish(verify_t *verify_p, const int verbose_b);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __VERIFY_H__ */